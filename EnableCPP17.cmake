@@ -0,0 +1,4 @@
+# The library and the examples need C++17 (if constexpr, std::as_const).
+SET(CMAKE_CXX_STANDARD 17)
+SET(CMAKE_CXX_STANDARD_REQUIRED ON)
+SET(CMAKE_CXX_EXTENSIONS OFF)
@@ -0,0 +1,311 @@
+//
+// MIT License.
+//
+// degski 2020
+// degski@gmail.com
+//
+// mcts_bench [max_threads [scale]]
+//
+// Benchmarks, as JSON on stdout: the random playouts of the games, compute_move at
+// 1 to max_threads threads in every search mode, and the selection and backup of a
+// node at various branching factors. The work done is fixed (scale multiplies it)
+// and the seeds are fixed, so runs differ only in the time they take.
+//
+
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+#include <mcts.h>
+
+#include "games/connect_four.h"
+#include "games/go.h"
+#include "games/kalaha.h"
+#include "games/nim.h"
+
+// A game of known shape: branching moves per ply, depth plies, and a winner that
+// follows from the moves played.
+class SyntheticGame {
+    public:
+    using Move        = int;
+    using Moves       = sax::compact_vector<Move>;
+    using ZobristHash = std::uint64_t;
+    using value_type  = int;
+
+    static constexpr Move no_move = -1;
+
+    SyntheticGame ( int branching_, int depth_ ) noexcept : branching ( branching_ ), depth ( depth_ ) {}
+
+    int playerToMove ( ) const noexcept { return player_to_move; }
+    ZobristHash zobrist ( ) const noexcept { return hash ^ static_cast<ZobristHash> ( player_to_move ); }
+
+    void do_move ( Move move ) noexcept {
+        hash = ( hash ^ static_cast<ZobristHash> ( move + 1 ) ) * 0x9e3779b97f4a7c15ull;
+        hash ^= hash >> 29;
+        ply += 1;
+        player_to_move = 3 - player_to_move;
+    }
+
+    bool has_moves ( ) const noexcept { return ply < depth; }
+    Moves get_moves ( ) const {
+        Moves moves;
+        if ( has_moves ( ) )
+            for ( Move move = 0; move < branching; ++move )
+                moves.push_back ( move );
+        return moves;
+    }
+
+    template<typename RandomEngine>
+    void do_random_move ( RandomEngine * engine ) {
+        do_move ( std::uniform_int_distribution<Move> ( 0, branching - 1 ) ( *engine ) );
+    }
+    void simulate ( std::vector<Move> & played ) {
+        static thread_local std::mt19937_64 engine ( 4711 );
+        while ( has_moves ( ) ) {
+            Move const move = std::uniform_int_distribution<Move> ( 0, branching - 1 ) ( engine );
+            do_move ( move );
+            played.push_back ( move );
+        }
+    }
+    int simulate ( ) {
+        static thread_local std::vector<Move> played;
+        played.clear ( );
+        simulate ( played );
+        return static_cast<int> ( played.size ( ) );
+    }
+
+    // Half points: 2 is a win, for the player to move when current_player_to_move
+    // moved last.
+    int get_result ( int current_player_to_move ) const noexcept {
+        int const winner = 1 + static_cast<int> ( hash >> 63 );
+        return winner == current_player_to_move ? 0 : 2;
+    }
+
+    private:
+    int branching, depth, ply = 0, player_to_move = 1;
+    ZobristHash hash = 0;
+};
+
+// True if State has what Mcts::compute_move needs (see mcts.h), the games that don't
+// are only played out.
+template<typename State, typename = void>
+struct searchable : std::false_type {};
+template<typename State>
+struct searchable<State, std::void_t<typename State::Moves, typename State::ZobristHash, typename State::value_type,
+                                     decltype ( std::declval<State const &> ( ).playerToMove ( ) ),
+                                     decltype ( std::declval<State const &> ( ).zobrist ( ) ),
+                                     decltype ( std::declval<State &> ( ).simulate ( ) )>> : std::true_type {};
+
+// Keeps the optimizer from dropping the work.
+volatile double sink = 0.0;
+
+// Separates the entries of a JSON array.
+class Separator {
+    public:
+    char const * operator( ) ( ) noexcept { return std::exchange ( first, false ) ? "\n    " : ",\n    "; }
+
+    private:
+    bool first = true;
+};
+
+template<typename State>
+void bench_playouts ( Separator & separator, char const * game, State const & start, std::int64_t playouts ) {
+    std::mt19937_64 engine ( 4711 );
+    double result    = 0.0;
+    std::int64_t moves = 0;
+    double const begin = Mcts::wall_time ( );
+    for ( std::int64_t i = 0; i < playouts; ++i ) {
+        State state = start;
+        while ( state.has_moves ( ) ) {
+            state.do_random_move ( &engine );
+            moves += 1;
+        }
+        result += static_cast<double> ( state.get_result ( 1 ) );
+    }
+    double const seconds = Mcts::wall_time ( ) - begin;
+    sink                 = sink + result;
+    std::cout << separator ( ) << "{ \"game\": \"" << game << "\", \"playouts\": " << playouts << ", \"moves\": " << moves
+              << ", \"seconds\": " << seconds << ", \"playouts_per_second\": " << playouts / seconds << " }";
+}
+
+// Every thread runs iterations iterations, in both parallelization modes and with
+// both allocation policies. Games that are not searchable are added to skipped.
+template<typename State>
+void bench_compute_move ( Separator & separator, Mcts::Engine & engine, char const * game, State const & state,
+                          std::vector<int> const & threads, int iterations, std::vector<std::string> & skipped ) {
+    if constexpr ( searchable<State>::value ) {
+        auto run = [ & ] ( auto allocation, char const * allocation_name, Mcts::Parallelization parallelization ) {
+            using Allocation = decltype ( allocation );
+            double single    = 0.0;
+            for ( int t : threads ) {
+                Mcts::ComputeOptions options;
+                options.number_of_threads = t;
+                options.max_iterations    = iterations;
+                options.verbose           = false;
+                options.parallelization   = parallelization;
+                Mcts::SearchProfile profile;
+                options.profile    = &profile;
+                double const begin = Mcts::wall_time ( );
+                sink               = sink + engine.compute_move<State, Allocation> ( state, options );
+                double const seconds = Mcts::wall_time ( ) - begin;
+                double const rate    = static_cast<double> ( t ) * iterations / seconds;
+                if ( t == 1 )
+                    single = rate;
+                std::cout << separator ( ) << "{ \"game\": \"" << game << "\", \"parallelization\": \""
+                          << ( parallelization == Mcts::Parallelization::root ? "root" : "tree" ) << "\", \"allocation\": \""
+                          << allocation_name << "\", \"threads\": " << t << ", \"iterations\": " << t * iterations
+                          << ", \"seconds\": " << seconds << ", \"iterations_per_second\": " << rate
+                          << ", \"speedup\": " << ( single > 0.0 ? rate / single : 0.0 );
+                if ( profile.iterations ) {
+                    std::cout << ", \"profile\": { \"selection\": " << profile.seconds[ Mcts::SearchProfile::selection ]
+                              << ", \"expansion\": " << profile.seconds[ Mcts::SearchProfile::expansion ]
+                              << ", \"simulation\": " << profile.seconds[ Mcts::SearchProfile::simulation ]
+                              << ", \"backpropagation\": " << profile.seconds[ Mcts::SearchProfile::backpropagation ]
+                              << ", \"average_depth\": " << profile.average_depth ( ) << ", \"nodes\": " << profile.nodes
+                              << ", \"bytes\": " << profile.bytes << " }";
+                }
+                std::cout << " }";
+            }
+        };
+        for ( auto parallelization : { Mcts::Parallelization::root, Mcts::Parallelization::tree } ) {
+            run ( Mcts::HeapAllocation ( ), "heap", parallelization );
+            run ( Mcts::ArenaAllocation ( ), "arena", parallelization );
+        }
+    }
+    else {
+        skipped.push_back ( game );
+    }
+}
+
+// A root with branching children, with some statistics. The children are selected by
+// UCT, each selection is counted as a visit.
+void bench_selection ( Separator & separator, int branching, std::int64_t calls ) {
+    using Node = Mcts::Node<SyntheticGame>;
+    Mcts::HeapAllocation::Arena arena;
+    sax::Rng rng ( 4711 );
+    SyntheticGame const state ( branching, 64 );
+    Node root ( state, arena );
+    while ( root.has_untried_moves ( ) ) {
+        auto const move          = root.get_untried_move ( &rng );
+        SyntheticGame next_state = state;
+        next_state.do_move ( move );
+        root.add_child ( move, next_state, arena );
+    }
+    for ( int i = 0; i < 16 * branching; ++i ) {
+        root.update_child ( static_cast<std::int32_t> ( rng ( ) % branching ), static_cast<int> ( rng ( ) % 3 ) );
+        root.visits += 1;
+    }
+    std::int64_t slots = 0;
+    double const begin = Mcts::wall_time ( );
+    for ( std::int64_t i = 0; i < calls; ++i ) {
+        std::int32_t const slot = root.select_child ( );
+        root.update_child ( slot, static_cast<int> ( i % 3 ) );
+        root.visits += 1;
+        slots += slot;
+    }
+    double const seconds = Mcts::wall_time ( ) - begin;
+    sink                 = sink + static_cast<double> ( slots );
+    std::cout << separator ( ) << "{ \"branching\": " << branching << ", \"calls\": " << calls << ", \"seconds\": " << seconds
+              << ", \"ns_per_call\": " << 1e9 * seconds / calls << " }";
+}
+
+// A path of depth nodes, each with branching children. Every backup goes up through a
+// random child of each node on the path, as DefaultPolicies::backup does it.
+void bench_backpropagation ( Separator & separator, int branching, int depth, std::int64_t backups ) {
+    using Node = Mcts::Node<SyntheticGame>;
+    Mcts::HeapAllocation::Arena arena;
+    sax::Rng rng ( 4711 );
+    SyntheticGame state ( branching, depth + 1 );
+    Node root ( state, arena );
+    std::vector<Node *> path ( 1, &root );
+    for ( int d = 0; d < depth; ++d ) {
+        Node * const node = path.back ( );
+        while ( node->has_untried_moves ( ) ) {
+            auto const move          = node->get_untried_move ( &rng );
+            SyntheticGame next_state = state;
+            next_state.do_move ( move );
+            node->add_child ( move, next_state, arena );
+        }
+        state.do_move ( node->child_moves[ 0 ] );
+        path.push_back ( &*node->children[ 0 ] );
+    }
+    while ( state.has_moves ( ) )
+        state.do_move ( 0 );
+    std::vector<std::int32_t> slots ( 4096 );
+    for ( auto & slot : slots )
+        slot = static_cast<std::int32_t> ( rng ( ) % branching );
+    std::int64_t results = 0;
+    double const begin   = Mcts::wall_time ( );
+    for ( std::int64_t i = 0; i < backups; ++i ) {
+        for ( int d = depth - 1; d >= 0; --d ) {
+            std::int32_t const slot = slots[ ( i + d ) & 4095 ];
+            results += Mcts::DefaultPolicies::backup ( *path[ d ], slot, *path[ d ]->children[ slot ], state, 0 );
+        }
+    }
+    double const seconds = Mcts::wall_time ( ) - begin;
+    sink                 = sink + static_cast<double> ( results );
+    std::cout << separator ( ) << "{ \"branching\": " << branching << ", \"depth\": " << depth << ", \"backups\": " << backups
+              << ", \"seconds\": " << seconds << ", \"ns_per_edge\": " << 1e9 * seconds / ( backups * depth ) << " }";
+}
+
+int main ( int argc, char ** argv ) {
+    int const max_threads =
+        argc > 1 ? std::max ( 1, std::atoi ( argv[ 1 ] ) ) : std::max ( 1, static_cast<int> ( std::thread::hardware_concurrency ( ) ) );
+    double const scale = argc > 2 ? std::max ( 0.001, std::atof ( argv[ 2 ] ) ) : 1.0;
+    auto scaled        = [ scale ] ( std::int64_t n ) { return std::max<std::int64_t> ( 1, static_cast<std::int64_t> ( n * scale ) ); };
+
+    std::vector<int> threads;
+    for ( int t = 1; t < max_threads; t *= 2 )
+        threads.push_back ( t );
+    threads.push_back ( max_threads );
+
+    std::cout.precision ( 6 );
+    std::cout << "{\n  \"version\": 1,\n  \"max_threads\": " << max_threads << ",\n  \"scale\": " << scale;
+
+    Separator playouts;
+    std::cout << ",\n  \"playouts\": [";
+    bench_playouts ( playouts, "ConnectFourState", ConnectFourState<6, 7> ( ), scaled ( 200'000 ) );
+    bench_playouts ( playouts, "GoState", GoState<9, 9> ( ), scaled ( 2'000 ) );
+    bench_playouts ( playouts, "KalahaState", KalahaState<6> ( ), scaled ( 200'000 ) );
+    bench_playouts ( playouts, "NimState", NimState ( 21 ), scaled ( 1'000'000 ) );
+    bench_playouts ( playouts, "SyntheticGame", SyntheticGame ( 8, 24 ), scaled ( 1'000'000 ) );
+    std::cout << "\n  ]";
+
+    Mcts::Engine engine ( max_threads );
+    Separator compute_move;
+    int const iterations = static_cast<int> ( scaled ( 100'000 ) );
+    std::vector<std::string> skipped;
+    std::cout << ",\n  \"compute_move\": [";
+    bench_compute_move ( compute_move, engine, "ConnectFourState", ConnectFourState<6, 7> ( ), threads, iterations, skipped );
+    bench_compute_move ( compute_move, engine, "GoState", GoState<9, 9> ( ), threads, iterations / 50, skipped );
+    bench_compute_move ( compute_move, engine, "KalahaState", KalahaState<6> ( ), threads, iterations, skipped );
+    bench_compute_move ( compute_move, engine, "NimState", NimState ( 21 ), threads, iterations, skipped );
+    bench_compute_move ( compute_move, engine, "SyntheticGame", SyntheticGame ( 8, 24 ), threads, iterations, skipped );
+    std::cout << "\n  ],\n  \"compute_move_skipped\": [";
+    Separator skipped_games;
+    for ( auto const & game : skipped )
+        std::cout << skipped_games ( ) << '"' << game << '"';
+    std::cout << "\n  ]";
+
+    Separator selection;
+    std::cout << ",\n  \"selection\": [";
+    for ( int branching : { 2, 8, 32, 128, 512 } )
+        bench_selection ( selection, branching, scaled ( 2'000'000 ) );
+    std::cout << "\n  ]";
+
+    Separator backpropagation;
+    std::cout << ",\n  \"backpropagation\": [";
+    for ( int branching : { 2, 8, 32, 128, 512 } )
+        bench_backpropagation ( backpropagation, branching, 16, scaled ( 2'000'000 ) );
+    std::cout << "\n  ]\n}" << std::endl;
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,58 @@
+//
+// MIT License.
+//
+// degski 2020
+// degski@gmail.com
+//
+// perft [game [depth [threads]]]
+//
+// Counts the positions up to a depth for the games (or one game: connect_four,
+// go, kalaha or nim), and the positions per second, see perft.h.
+//
+
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+#include <perft.h>
+
+#include "games/connect_four.h"
+#include "games/go.h"
+#include "games/kalaha.h"
+#include "games/nim.h"
+
+template<typename State>
+void run ( char const * game, State const & state, int depth, int threads ) {
+    auto const counts = Mcts::perft ( state, depth, threads );
+    std::cout << game << ", depth " << depth << ", " << threads << " threads: " << counts.nodes << " nodes, " << counts.leaves
+              << " leaves, " << counts.terminals << " terminals, " << counts.seconds << " seconds, "
+              << counts.nodes_per_second ( ) << " nodes / second." << std::endl;
+}
+
+int main ( int argc, char ** argv ) {
+    std::string const game = argc > 1 ? argv[ 1 ] : "";
+    int const depth        = argc > 2 ? std::atoi ( argv[ 2 ] ) : -1;
+    int const threads =
+        argc > 3 ? std::max ( 1, std::atoi ( argv[ 3 ] ) ) : std::max ( 1, static_cast<int> ( std::thread::hardware_concurrency ( ) ) );
+    bool found = false;
+    // The depths are the defaults, a few seconds each.
+    auto play = [ & ] ( char const * name, auto const & state, int default_depth ) {
+        if ( game.empty ( ) or game == name ) {
+            run ( name, state, depth < 0 ? default_depth : depth, threads );
+            found = true;
+        }
+    };
+    play ( "connect_four", ConnectFourState<6, 7> ( ), 9 );
+    play ( "go", GoState<5, 5> ( ), 4 );
+    play ( "kalaha", KalahaState<6> ( ), 12 );
+    play ( "nim", NimState ( 26 ), 26 );
+    if ( not found ) {
+        std::cerr << "Unknown game " << game << ", the games are connect_four, go, kalaha and nim." << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,58 @@
+//
+// MIT License.
+//
+// degski 2020
+// degski@gmail.com
+//
+// Builds opening books (see opening_book.h): every position up to a depth is
+// searched on an Engine, transpositions once, and the statistics of its moves
+// become the entries of the book.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <iostream>
+#include <unordered_set>
+#include <vector>
+
+#include "mcts.h"
+#include "opening_book.h"
+
+namespace Mcts {
+
+// Searches root_state and the positions up to depth_ moves after it with options_,
+// and returns the book entries.
+template<typename State, typename Allocation = HeapAllocation>
+std::vector<BookEntry> build_opening_book ( State const & root_state, int depth_, ComputeOptions const & options_,
+                                            Engine & engine_ = default_engine ( ) ) {
+    std::vector<BookEntry> entries;
+    std::vector<State> level ( 1, root_state ), next;
+    std::unordered_set<std::uint64_t> seen{ static_cast<std::uint64_t> ( root_state.zobrist ( ) ) };
+    for ( int depth = 0; depth <= depth_ and not level.empty ( ); ++depth ) {
+        if ( options_.verbose )
+            std::cerr << "Book: searching " << level.size ( ) << " positions at depth " << depth << "." << std::endl;
+        next.clear ( );
+        for ( auto const & state : level ) {
+            if ( not state.has_moves ( ) )
+                continue;
+            Trees<State, Allocation> trees;
+            engine_.grow ( trees, state, options_ );
+            auto const hash = static_cast<std::uint64_t> ( state.zobrist ( ) );
+            for ( auto const & move : root_statistics ( trees ) )
+                entries.push_back ( BookEntry{ hash, static_cast<std::int32_t> ( move.move ), static_cast<std::int32_t> ( move.visits ), move.wins, 0 } );
+            if ( depth < depth_ ) {
+                for ( auto const & move : state.get_moves ( ) ) {
+                    State child = state;
+                    child.do_move ( move );
+                    if ( seen.insert ( static_cast<std::uint64_t> ( child.zobrist ( ) ) ).second )
+                        next.push_back ( child );
+                }
+            }
+        }
+        std::swap ( level, next );
+    }
+    return entries;
+}
+
+} // namespace Mcts
@@ -0,0 +1,268 @@
+//
+// MIT License.
+//
+// degski 2020
+// degski@gmail.com
+//
+// A compact search tree: 16 byte nodes in one index-addressed store.
+//
+// A CompactNode holds the statistics of the edge into it (visits, and wins in
+// half points for the player who moved into it), its move in 16 bits and the
+// index and size of its block of children. All children of a node are created
+// at once, on its second visit, as one contiguous block at the end of the
+// store. So there are no untried move lists, no parent pointers and no per-node
+// heap allocations, a tree is a single std::vector. Four nodes share a cache
+// line and selection scans one block.
+//
+// A tree is grown by one thread. compute_compact_move grows one tree per
+// thread (root parallelization) on an Engine and merges the root children.
+//
+// Moves must fit in 16 bits (0 .. 65'535), a node has at most 65'535 children
+// and a tree at most 2^32 - 1 nodes.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <future>
+#include <limits>
+#include <vector>
+
+#include "mcts.h"
+
+namespace Mcts {
+
+struct CompactNode {
+    std::int32_t visits;
+    float wins;                       // In half points.
+    std::uint32_t first_child;        // 0 until expanded (the root is nobody's child).
+    std::uint16_t number_of_children; // 0 for a terminal position.
+    std::uint16_t move;
+
+    bool is_expanded ( ) const noexcept { return first_child; }
+};
+
+static_assert ( sizeof ( CompactNode ) == 16, "a CompactNode takes 16 bytes" );
+
+template<typename State>
+class CompactTree {
+
+    public:
+    using Move  = typename State::Move;
+    using Index = std::uint32_t;
+
+    CompactTree ( ) : nodes ( 1, CompactNode{ 0, 0.0f, 0, 0, 0 } ) {}
+    // A copy of the n_ nodes of another tree, of a MappedTree for instance.
+    CompactTree ( CompactNode const * nodes_, std::size_t n_ ) : nodes ( nodes_, nodes_ + n_ ) { attest ( n_ > 0 ); }
+
+    static constexpr Index root ( ) noexcept { return 0; }
+
+    CompactNode & operator[] ( Index i_ ) noexcept { return nodes[ i_ ]; }
+    CompactNode const & operator[] ( Index i_ ) const noexcept { return nodes[ i_ ]; }
+    Move move ( Index i_ ) const noexcept { return static_cast<Move> ( nodes[ i_ ].move ); }
+
+    std::size_t size ( ) const noexcept { return nodes.size ( ); }
+    std::size_t bytes ( ) const noexcept { return nodes.capacity ( ) * sizeof ( CompactNode ); }
+    // The store grows as the tree does, but not beyond bytes_ (0 is no limit). The
+    // expansion that reaches the limit still gets the room it needs.
+    void limit ( std::size_t bytes_ ) noexcept { max_nodes = bytes_ / sizeof ( CompactNode ); }
+
+    // Creates the children of i_, one per move of state_ (which is the position at
+    // i_), in random order. Returns their number.
+    template<typename RandomEngine>
+    std::uint16_t expand ( Index i_, State const & state_, RandomEngine * engine_ );
+
+    // Returns the index of the child of i_ with the highest UCT score, i_ has children.
+    Index select_child ( Index i_ ) const noexcept;
+
+    private:
+    // Makes room for n_ nodes.
+    void grow ( std::size_t n_ ) {
+        if ( n_ <= nodes.capacity ( ) )
+            return;
+        std::size_t capacity = std::max ( n_, 2 * nodes.capacity ( ) );
+        if ( max_nodes )
+            capacity = std::max ( n_, std::min ( capacity, max_nodes ) );
+        nodes.reserve ( capacity );
+    }
+
+    std::vector<CompactNode> nodes;
+    std::size_t max_nodes = 0;
+};
+
+template<typename State>
+template<typename RandomEngine>
+std::uint16_t CompactTree<State>::expand ( Index i_, State const & state_, RandomEngine * engine_ ) {
+    auto const moves = state_.get_moves ( );
+    check ( moves.size ( ) <= std::numeric_limits<std::uint16_t>::max ( ), "too many moves for a CompactTree" );
+    check ( nodes.size ( ) + moves.size ( ) <= std::numeric_limits<Index>::max ( ), "too many nodes for a CompactTree" );
+    auto const first = static_cast<Index> ( nodes.size ( ) );
+    auto const n     = static_cast<std::uint16_t> ( moves.size ( ) );
+    grow ( nodes.size ( ) + n );
+    for ( auto const & move : moves ) {
+        attest ( 0 <= move and move <= std::numeric_limits<std::uint16_t>::max ( ) );
+        nodes.push_back ( CompactNode{ 0, 0.0f, 0, 0, static_cast<std::uint16_t> ( move ) } );
+    }
+    // Unvisited children are selected in order.
+    for ( std::uint16_t i = n; i > 1; --i )
+        std::swap ( nodes[ first + i - 1 ], nodes[ first + sax::uniform_int_distribution<std::uint16_t> ( 0, i - 1 ) ( *engine_ ) ] );
+    // A terminal position is expanded as well, into an empty block.
+    nodes[ i_ ].first_child        = first;
+    nodes[ i_ ].number_of_children = n;
+    return n;
+}
+
+template<typename State>
+typename CompactTree<State>::Index CompactTree<State>::select_child ( Index i_ ) const noexcept {
+    CompactNode const & node = nodes[ i_ ];
+    attest ( node.number_of_children );
+    float const two_log_n = 2.0f * std::log ( static_cast<float> ( node.visits > 0 ? node.visits : 1 ) );
+    Index best            = node.first_child;
+    float best_score      = -std::numeric_limits<float>::max ( );
+    for ( Index i = node.first_child, end = node.first_child + node.number_of_children; i < end; ++i ) {
+        if ( float const score = uct_score ( nodes[ i ].visits, nodes[ i ].wins, two_log_n ); score > best_score ) {
+            best_score = score;
+            best       = i;
+        }
+    }
+    return best;
+}
+
+// Runs the search iterations on a compact tree, with the budget of options (the
+// iterations, the time, stop and the memory). The other options don't apply.
+template<typename State>
+void grow_compact_tree ( CompactTree<State> & tree, State const & root_state, ComputeOptions const & options,
+                         sax::Rng::result_type seed_ ) {
+    using Index = typename CompactTree<State>::Index;
+    sax::Rng random_engine ( seed_ );
+    attest ( options.max_iterations >= 0 or options.max_time >= 0 or options.stop );
+    tree.limit ( options.max_memory_bytes );
+
+    // The nodes visited in this iteration, with the player to move there.
+    struct Step {
+        Index node;
+        decltype ( root_state.playerToMove ( ) ) player_to_move;
+    };
+    std::vector<Step> path;
+    path.reserve ( 64 );
+
+    bool const timed = options.verbose or options.max_time >= 0;
+    Deadline deadline ( options.max_time, options.time_tolerance );
+    double print_time = deadline.start_time ( );
+
+    for ( int iter = 1; iter <= options.max_iterations or options.max_iterations < 0; ++iter ) {
+
+        Index node  = tree.root ( );
+        State state = root_state;
+        path.assign ( 1, Step{ node, state.playerToMove ( ) } );
+
+        // Select a path through the tree to a leaf node.
+        while ( tree[ node ].number_of_children ) {
+            node = tree.select_child ( node );
+            state.do_move ( tree.move ( node ) );
+            path.push_back ( Step{ node, state.playerToMove ( ) } );
+        }
+        // A leaf is expanded when it is visited for the second time, while there is
+        // memory left, and the first of its (shuffled) children is played.
+        bool const full = options.max_memory_bytes and tree.size ( ) * sizeof ( CompactNode ) >= options.max_memory_bytes;
+        if ( not tree[ node ].is_expanded ( ) and ( node == tree.root ( ) or tree[ node ].visits ) and not full ) {
+            if ( tree.expand ( node, state, &random_engine ) ) {
+                node = tree[ node ].first_child;
+                state.do_move ( tree.move ( node ) );
+                path.push_back ( Step{ node, state.playerToMove ( ) } );
+            }
+        }
+
+        // We now play randomly until the game ends.
+        state.simulate ( );
+
+        // Backpropagate the result up the path, the root only counts the visit.
+        for ( std::size_t i = path.size ( ) - 1; i > 0; --i ) {
+            CompactNode & step = tree[ path[ i ].node ];
+            step.visits += 1;
+            step.wins += static_cast<float> ( state.get_result ( path[ i ].player_to_move ) );
+        }
+        tree[ tree.root ( ) ].visits += 1;
+
+        if ( options.stop and options.stop->load ( std::memory_order_relaxed ) )
+            break;
+        if ( timed and ( deadline.tick ( ) or iter == options.max_iterations ) ) {
+            double const time = deadline.now ( );
+            if ( options.verbose && ( time - print_time >= 1.0 or iter == options.max_iterations ) ) {
+                std::cerr << iter << " games played (" << double ( iter ) / ( time - deadline.start_time ( ) ) << " / second)."
+                          << std::endl;
+                print_time = time;
+            }
+
+            if ( deadline.passed ( time ) )
+                break;
+        }
+    }
+}
+
+template<typename State>
+CompactTree<State> compute_compact_tree ( State const root_state, ComputeOptions const options, sax::Rng::result_type seed_ ) {
+    CompactTree<State> tree;
+    grow_compact_tree ( tree, root_state, options, seed_ );
+    return tree;
+}
+
+// Merges the children of the roots of the trees, ordered by move.
+template<typename State>
+std::vector<MoveStatistics<typename State::Move>> root_statistics ( std::vector<CompactTree<State>> const & trees ) {
+    static thread_local MoveMerge<typename State::Move> merge;
+    merge.clear ( );
+    for ( auto & tree : trees ) {
+        CompactNode const & root = tree[ tree.root ( ) ];
+        for ( std::uint32_t i = root.first_child; i < root.first_child + root.number_of_children; ++i ) {
+            auto & statistics = merge[ tree.move ( i ) ];
+            statistics.visits += tree[ i ].visits;
+            statistics.wins += tree[ i ].wins;
+        }
+    }
+    return merge.sorted ( );
+}
+
+// As compute_move, with a compact tree per thread. The memory budget is split
+// between the trees.
+template<typename State>
+typename State::Move compute_compact_move ( State const & root_state, ComputeOptions const & options = ComputeOptions ( ),
+                                           Engine & engine_ = default_engine ( ) ) {
+    auto moves = root_state.get_moves ( );
+    attest ( moves.size ( ) > 0 );
+    if ( moves.size ( ) == 1 )
+        return moves[ 0 ];
+    if ( auto const move = book_move ( root_state, moves, options ); move != State::no_move )
+        return move;
+    double start_time = wall_time ( );
+    std::vector<CompactTree<State>> trees ( options.number_of_threads );
+    ComputeOptions job_options   = options;
+    job_options.verbose          = false;
+    job_options.max_memory_bytes = options.max_memory_bytes / options.number_of_threads;
+    std::vector<std::future<void>> futures;
+    engine_.thread_pool ( ).reserve ( options.number_of_threads );
+    for ( int t = 0; t < options.number_of_threads; ++t ) {
+        auto const seed = 18'446'744'073'709'551'557ull * t + 0x0fce58188743146dull;
+        // The nodes of a tree are first touched by the thread that grows it, on its NUMA node.
+        futures.push_back ( engine_.thread_pool ( ).submit_to ( t, [ seed, &root_state, &job_options, &tree = trees[ t ] ] ( ) {
+            grow_compact_tree ( tree, root_state, job_options, seed );
+        } ) );
+    }
+    for ( auto & future : futures )
+        future.get ( );
+    auto const best = best_move ( root_statistics ( trees ), State::no_move );
+    if ( options.verbose ) {
+        std::int64_t games_played = 0;
+        for ( auto & tree : trees )
+            games_played += tree[ tree.root ( ) ].visits;
+        double const time = wall_time ( );
+        std::cerr << "Best: " << best << ", " << games_played << " games played in " << float ( time - start_time ) << " s. ("
+                  << float ( games_played ) / ( time - start_time ) << " / second, " << options.number_of_threads
+                  << " parallel jobs)." << std::endl;
+    }
+    return best;
+}
+
+} // namespace Mcts
@@ -0,0 +1,389 @@
+//
+// MIT License.
+//
+// degski 2020
+// degski@gmail.com
+//
+// Root parallelization over processes (and hosts).
+//
+// A worker process listens on a port and serves search requests: it grows
+// trees for the requested root state on its own Engine and sends back the
+// statistics of the root moves. A coordinator (compute_move_distributed)
+// sends the root state to all its workers, searches locally meanwhile, and
+// merges the root moves of everything that came back, as the threads of one
+// process are merged. A worker that can't be reached, crashes or times out
+// is left out of the merge, the move is still computed.
+//
+// The protocol is binary and in native byte order, coordinator and workers
+// must run the same build. The root state is sent as its bytes, so State
+// must be trivially copyable, and moves must be integral.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <future>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined( _WIN32 )
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <winsock2.h>
+#    include <ws2tcpip.h>
+#    pragma comment( lib, "Ws2_32.lib" )
+#else
+#    include <arpa/inet.h>
+#    include <netdb.h>
+#    include <netinet/in.h>
+#    include <netinet/tcp.h>
+#    include <sys/socket.h>
+#    include <sys/time.h>
+#    include <unistd.h>
+#endif
+
+#include "mcts.h"
+
+namespace Mcts {
+
+#if defined( _WIN32 )
+using SocketHandle                         = SOCKET;
+inline constexpr SocketHandle no_socket    = INVALID_SOCKET;
+inline void close_socket ( SocketHandle s_ ) noexcept { ::closesocket ( s_ ); }
+// Winsock has to be started once per process.
+inline void start_sockets ( ) {
+    static bool const started = [] ( ) {
+        WSADATA data;
+        return WSAStartup ( MAKEWORD ( 2, 2 ), &data ) == 0;
+    }( );
+    if ( not started )
+        throw std::runtime_error ( "cannot start winsock" );
+}
+#else
+using SocketHandle                      = int;
+inline constexpr SocketHandle no_socket = -1;
+inline void close_socket ( SocketHandle s_ ) noexcept { ::close ( s_ ); }
+inline void start_sockets ( ) noexcept {}
+#endif
+
+// A connected TCP socket. All operations throw std::runtime_error on failure.
+class Socket {
+
+    public:
+    Socket ( ) noexcept = default;
+    explicit Socket ( SocketHandle handle_ ) noexcept : handle ( handle_ ) {}
+    Socket ( Socket && other_ ) noexcept : handle ( std::exchange ( other_.handle, no_socket ) ) {}
+    Socket & operator= ( Socket && other_ ) noexcept {
+        close ( );
+        handle = std::exchange ( other_.handle, no_socket );
+        return *this;
+    }
+    Socket ( Socket const & ) = delete;
+    Socket & operator= ( Socket const & ) = delete;
+    ~Socket ( ) noexcept { close ( ); }
+
+    // Connects to host_ (a name or an address) on port_.
+    static Socket connect ( std::string const & host_, std::uint16_t port_ );
+
+    void send ( void const * data_, std::size_t size_ );
+    void receive ( void * data_, std::size_t size_ );
+    // Receives fail after seconds_ without data, negative is never.
+    void set_timeout ( double seconds_ );
+
+    void close ( ) noexcept {
+        if ( handle != no_socket )
+            close_socket ( std::exchange ( handle, no_socket ) );
+    }
+
+    private:
+    SocketHandle handle = no_socket;
+};
+
+inline Socket Socket::connect ( std::string const & host_, std::uint16_t port_ ) {
+    start_sockets ( );
+    addrinfo hints{ };
+    hints.ai_family   = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    addrinfo * addresses = nullptr;
+    if ( ::getaddrinfo ( host_.c_str ( ), std::to_string ( port_ ).c_str ( ), &hints, &addresses ) != 0 )
+        throw std::runtime_error ( "cannot resolve " + host_ );
+    Socket socket;
+    for ( addrinfo * address = addresses; address and socket.handle == no_socket; address = address->ai_next ) {
+        SocketHandle handle = ::socket ( address->ai_family, address->ai_socktype, address->ai_protocol );
+        if ( handle == no_socket )
+            continue;
+        if ( ::connect ( handle, address->ai_addr, static_cast<int> ( address->ai_addrlen ) ) == 0 )
+            socket.handle = handle;
+        else
+            close_socket ( handle );
+    }
+    ::freeaddrinfo ( addresses );
+    if ( socket.handle == no_socket )
+        throw std::runtime_error ( "cannot connect to " + host_ + ":" + std::to_string ( port_ ) );
+    int const no_delay = 1;
+    ::setsockopt ( socket.handle, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<char const *> ( &no_delay ), sizeof ( no_delay ) );
+    return socket;
+}
+
+inline void Socket::send ( void const * data_, std::size_t size_ ) {
+#if defined( MSG_NOSIGNAL )
+    int const flags = MSG_NOSIGNAL; // A closed connection is an error, not a signal.
+#else
+    int const flags = 0;
+#endif
+    char const * data = static_cast<char const *> ( data_ );
+    while ( size_ ) {
+        auto const sent = ::send ( handle, data, static_cast<int> ( size_ ), flags );
+        if ( sent <= 0 )
+            throw std::runtime_error ( "connection lost while sending" );
+        data += sent;
+        size_ -= static_cast<std::size_t> ( sent );
+    }
+}
+
+inline void Socket::receive ( void * data_, std::size_t size_ ) {
+    char * data = static_cast<char *> ( data_ );
+    while ( size_ ) {
+        auto const received = ::recv ( handle, data, static_cast<int> ( size_ ), 0 );
+        if ( received <= 0 )
+            throw std::runtime_error ( "connection lost while receiving" );
+        data += received;
+        size_ -= static_cast<std::size_t> ( received );
+    }
+}
+
+inline void Socket::set_timeout ( double seconds_ ) {
+#if defined( _WIN32 )
+    DWORD const timeout = seconds_ < 0 ? 0 : static_cast<DWORD> ( seconds_ * 1000 );
+#else
+    timeval timeout{ };
+    if ( seconds_ >= 0 ) {
+        timeout.tv_sec  = static_cast<decltype ( timeout.tv_sec ) > ( seconds_ );
+        timeout.tv_usec = static_cast<decltype ( timeout.tv_usec ) > ( ( seconds_ - timeout.tv_sec ) * 1e6 );
+    }
+#endif
+    ::setsockopt ( handle, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<char const *> ( &timeout ), sizeof ( timeout ) );
+}
+
+// A listening TCP socket.
+class Listener {
+
+    public:
+    // Port 0 picks a free port, see port ( ). With loopback_only_, only processes on
+    // this host can connect.
+    explicit Listener ( std::uint16_t port_ = 0, bool loopback_only_ = true );
+    Listener ( Listener && ) noexcept = default;
+    Listener & operator= ( Listener && ) noexcept = default;
+
+    std::uint16_t port ( ) const noexcept { return bound_port; }
+    // Waits for a connection.
+    Socket accept ( );
+    void close ( ) noexcept { socket.close ( ); }
+
+    private:
+    SocketHandle handle = no_socket; // Owned by socket.
+    Socket socket;
+    std::uint16_t bound_port = 0;
+};
+
+inline Listener::Listener ( std::uint16_t port_, bool loopback_only_ ) {
+    start_sockets ( );
+    handle = ::socket ( AF_INET, SOCK_STREAM, IPPROTO_TCP );
+    if ( handle == no_socket )
+        throw std::runtime_error ( "cannot create a socket" );
+    socket          = Socket ( handle );
+    int const reuse = 1;
+    ::setsockopt ( handle, SOL_SOCKET, SO_REUSEADDR, reinterpret_cast<char const *> ( &reuse ), sizeof ( reuse ) );
+    sockaddr_in address{ };
+    address.sin_family      = AF_INET;
+    address.sin_port        = htons ( port_ );
+    address.sin_addr.s_addr = htonl ( loopback_only_ ? INADDR_LOOPBACK : INADDR_ANY );
+    socklen_t length        = sizeof ( address );
+    if ( ::bind ( handle, reinterpret_cast<sockaddr *> ( &address ), sizeof ( address ) ) != 0 or ::listen ( handle, 16 ) != 0 or
+         ::getsockname ( handle, reinterpret_cast<sockaddr *> ( &address ), &length ) != 0 )
+        throw std::runtime_error ( "cannot listen on port " + std::to_string ( port_ ) );
+    bound_port = ntohs ( address.sin_port );
+}
+
+inline Socket Listener::accept ( ) {
+    SocketHandle const connection = ::accept ( handle, nullptr, nullptr );
+    if ( connection == no_socket )
+        throw std::runtime_error ( "accept failed" );
+    return Socket ( connection );
+}
+
+// The wire format.
+struct SearchRequest {
+    static constexpr std::uint32_t magic_number = 0x4d435453; // "MCTS"
+    static constexpr std::uint32_t version      = 1;
+
+    std::uint32_t magic;
+    std::uint32_t protocol_version;
+    std::uint64_t seed_offset;
+    std::int32_t max_iterations;
+    float max_time;
+    std::int32_t number_of_threads;
+    std::uint32_t state_size; // Followed by the bytes of the root state.
+};
+
+struct SearchResponse {
+    std::uint32_t magic;
+    std::uint32_t number_of_moves; // Followed by this many WireMoveStatistics.
+};
+
+struct WireMoveStatistics {
+    std::int64_t move;
+    std::int64_t visits;
+    float wins;
+    std::int32_t proof;
+};
+
+// How long the coordinator waits for a worker whose search has no time limit (only
+// max_iterations), and how long a worker waits for the rest of a request.
+inline constexpr double untimed_search_timeout = 600.0;
+inline constexpr double request_timeout        = 10.0;
+
+// Serves search requests on listener_ with engine_, one connection after the other,
+// max_connections_ of them (negative is forever). A connection that fails is
+// dropped, the worker carries on. The placement of engine_ is the worker's choice;
+// the workers that share a host should not all pin their threads compactly.
+template<typename State, typename Allocation = HeapAllocation>
+void serve_searches ( Listener & listener_, Engine & engine_, int max_connections_ = -1 ) {
+    static_assert ( std::is_trivially_copyable<State>::value, "the root state is sent as its bytes" );
+    for ( int connections = 0; max_connections_ < 0 or connections < max_connections_; ++connections ) {
+        Socket socket = listener_.accept ( );
+        try {
+            socket.set_timeout ( request_timeout );
+            SearchRequest request;
+            socket.receive ( &request, sizeof ( request ) );
+            if ( request.magic != SearchRequest::magic_number or request.protocol_version != SearchRequest::version or
+                 request.state_size != sizeof ( State ) )
+                throw std::runtime_error ( "bad search request" );
+            typename std::aligned_storage<sizeof ( State ), alignof ( State )>::type state_bytes;
+            socket.receive ( &state_bytes, sizeof ( State ) );
+            State const & root_state = *reinterpret_cast<State const *> ( &state_bytes );
+            ComputeOptions options;
+            options.max_iterations    = request.max_iterations;
+            options.max_time          = request.max_time;
+            options.number_of_threads = request.number_of_threads;
+            options.verbose           = false;
+            Trees<State, Allocation> trees;
+            engine_.grow ( trees, root_state, options, request.seed_offset );
+            auto const statistics = root_statistics ( trees );
+            SearchResponse const response{ SearchRequest::magic_number, static_cast<std::uint32_t> ( statistics.size ( ) ) };
+            std::vector<WireMoveStatistics> moves;
+            moves.reserve ( statistics.size ( ) );
+            for ( auto const & move : statistics )
+                moves.push_back ( WireMoveStatistics{ static_cast<std::int64_t> ( move.move ), move.visits, move.wins,
+                                                      static_cast<std::int32_t> ( move.proof ) } );
+            socket.send ( &response, sizeof ( response ) );
+            socket.send ( moves.data ( ), moves.size ( ) * sizeof ( WireMoveStatistics ) );
+        }
+        catch ( std::runtime_error & ) {
+        }
+    }
+}
+
+struct WorkerAddress {
+    std::string host;
+    std::uint16_t port;
+};
+
+// Searches root_state on the workers and, with options.number_of_threads > 0, on
+// engine_ as well, and returns the best move of the merged root statistics. The
+// workers search with the budget of options, with as many threads as they were
+// asked for in worker_threads_.
+template<typename State, typename Allocation = HeapAllocation>
+typename State::Move compute_move_distributed ( State const & root_state, ComputeOptions const & options,
+                                                std::vector<WorkerAddress> const & workers_, int worker_threads_ = 4,
+                                                Engine & engine_ = default_engine ( ) ) {
+    using Move = typename State::Move;
+    static_assert ( std::is_trivially_copyable<State>::value, "the root state is sent as its bytes" );
+    static_assert ( std::is_integral<Move>::value, "moves are sent as integers" );
+    auto moves = root_state.get_moves ( );
+    attest ( moves.size ( ) > 0 );
+    if ( moves.size ( ) == 1 )
+        return moves[ 0 ];
+    if ( auto const move = book_move ( root_state, moves, options ); move != State::no_move )
+        return move;
+    double const start_time = wall_time ( );
+
+    // Every worker (and every thread in it) gets seeds of its own.
+    std::vector<Socket> sockets;
+    for ( std::size_t w = 0; w < workers_.size ( ); ++w ) {
+        try {
+            Socket socket = Socket::connect ( workers_[ w ].host, workers_[ w ].port );
+            SearchRequest const request{ SearchRequest::magic_number,
+                                         SearchRequest::version,
+                                         static_cast<std::uint64_t> ( options.number_of_threads + w * worker_threads_ ),
+                                         options.max_iterations,
+                                         options.max_time,
+                                         worker_threads_,
+                                         sizeof ( State ) };
+            socket.send ( &request, sizeof ( request ) );
+            socket.send ( &root_state, sizeof ( State ) );
+            // Don't wait for ever on a worker that hangs.
+            socket.set_timeout ( ( options.max_time >= 0 ? 2.0 * options.max_time : untimed_search_timeout ) + 10.0 );
+            sockets.push_back ( std::move ( socket ) );
+        }
+        catch ( std::runtime_error & error ) {
+            if ( options.verbose )
+                std::cerr << "Worker " << workers_[ w ].host << ":" << workers_[ w ].port << " left out: " << error.what ( ) << std::endl;
+        }
+    }
+
+    Trees<State, Allocation> trees;
+    if ( options.number_of_threads > 0 )
+        engine_.grow ( trees, root_state, options );
+    MoveMerge<Move> merge;
+    for ( auto const & move : root_statistics ( trees ) )
+        merge[ move.move ] = move;
+
+    std::vector<WireMoveStatistics> received;
+    std::size_t answered = 0;
+    for ( auto & socket : sockets ) {
+        try {
+            SearchResponse response;
+            socket.receive ( &response, sizeof ( response ) );
+            // The root has no more moves than these.
+            if ( response.magic != SearchRequest::magic_number or response.number_of_moves > static_cast<std::uint32_t> ( moves.size ( ) ) )
+                throw std::runtime_error ( "bad search response" );
+            received.resize ( response.number_of_moves );
+            socket.receive ( received.data ( ), received.size ( ) * sizeof ( WireMoveStatistics ) );
+            for ( auto const & move : received ) {
+                auto & statistics = merge[ static_cast<Move> ( move.move ) ];
+                statistics.visits += move.visits;
+                statistics.wins += move.wins;
+                if ( move.proof != static_cast<std::int32_t> ( Proof::none ) )
+                    statistics.proof = static_cast<Proof> ( move.proof );
+            }
+            ++answered;
+        }
+        catch ( std::runtime_error & error ) {
+            if ( options.verbose )
+                std::cerr << "Worker left out: " << error.what ( ) << std::endl;
+        }
+    }
+    // Nothing came back and nothing was searched here, search here after all.
+    if ( merge.empty ( ) ) {
+        ComputeOptions local_options     = options;
+        local_options.number_of_threads = std::max ( 1, options.number_of_threads );
+        engine_.grow ( trees, root_state, local_options );
+        for ( auto const & move : root_statistics ( trees ) )
+            merge[ move.move ] = move;
+    }
+
+    auto const best = best_move ( merge.sorted ( ), State::no_move );
+    if ( options.verbose )
+        std::cerr << "Best: " << best << ", " << answered << " of " << workers_.size ( ) << " workers answered in "
+                  << float ( wall_time ( ) - start_time ) << " s." << std::endl;
+    return best;
+}
+
+} // namespace Mcts
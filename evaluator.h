@@ -0,0 +1,62 @@
+//
+// MIT License.
+//
+// degski 2020
+// degski@gmail.com
+//
+// Move priors for PUCT selection.
+//
+// A PriorEvaluator scores the moves of positions, a batch at a time. The
+// search collects the leaves it expands over evaluator_batch_size iterations
+// and hands them over in one call, so an expensive evaluator (a small network,
+// a pattern matcher) pays its fixed costs once per batch. Every search thread
+// collects and evaluates its own batches, evaluate ( ) is called concurrently
+// and must be thread-safe.
+//
+// The priors of a leaf need not be normalized, the search does that. Leaves
+// whose priors are all zero (or less) get uniform priors.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+namespace Mcts {
+
+// Lets ComputeOptions hold an evaluator without knowing the State.
+class PriorEvaluatorBase {
+
+    public:
+    virtual ~PriorEvaluatorBase ( ) noexcept = default;
+};
+
+// The leaves of a batch. The moves of leaf i are moves[ offsets[ i ] ] up to
+// moves[ offsets[ i + 1 ] ], their priors go to priors at the same indices.
+template<typename State>
+struct LeafBatch {
+    using Move = typename State::Move;
+
+    std::vector<State> states;
+    std::vector<Move> moves;
+    std::vector<std::size_t> offsets{ 0 };
+    std::vector<float> priors;
+
+    std::size_t size ( ) const noexcept { return states.size ( ); }
+    void clear ( ) noexcept {
+        states.clear ( );
+        moves.clear ( );
+        offsets.resize ( 1 );
+        priors.clear ( );
+    }
+};
+
+template<typename State>
+class PriorEvaluator : public PriorEvaluatorBase {
+
+    public:
+    // Fills batch_.priors (it has the size of batch_.moves).
+    virtual void evaluate ( LeafBatch<State> & batch_ ) = 0;
+};
+
+} // namespace Mcts
@@ -18,20 +18,35 @@ void main_program ( ) {
     Mcts::ComputeOptions player1_options, player2_options;
     player1_options.max_iterations = 100'000;
     player1_options.verbose        = true;
+
+    // Player 1 plays the opening from the book, if one has been built (connect_four_book).
+    Mcts::OpeningBook book;
+    try {
+        book                 = Mcts::OpeningBook ( "connect_four.book" );
+        player1_options.book = &book;
+    }
+    catch ( std::runtime_error & ) {
+    }
     player2_options.max_iterations = 10'000;
     player2_options.verbose        = true;
 
+    // Player 1 thinks on the human's time as well, the trees are kept between moves.
+    Mcts::ComputeOptions ponder_options = player1_options;
+    ponder_options.max_iterations       = 1'000'000;
+    Mcts::Search<State> player1, player2;
+
     State state;
     while ( state.has_moves ( ) ) {
         cout << endl << "State: " << state << endl;
 
         State::Move move = State::no_move;
         if ( state.player_to_move == 1 ) {
-            move = Mcts::compute_move ( state, player1_options );
+            move = player1.compute_move ( state, player1_options );
             state.do_move ( move );
         }
         else {
             if ( human_player ) {
+                player1.ponder ( state, ponder_options );
                 while ( true ) {
                     cout << "Input your move: ";
                     move = State::no_move;
@@ -46,7 +61,7 @@ void main_program ( ) {
                 }
             }
             else {
-                move = Mcts::compute_move ( state, player2_options );
+                move = player2.compute_move ( state, player2_options );
                 state.do_move ( move );
             }
         }
@@ -54,10 +69,10 @@ void main_program ( ) {
 
     cout << endl << "Final state: " << state << endl;
 
-    if ( state.get_result ( 2 ) == 1.0 ) {
+    if ( state.get_result ( 2 ) == 2 ) {
         cout << "Player 1 wins!" << endl;
     }
-    else if ( state.get_result ( 1 ) == 1.0 ) {
+    else if ( state.get_result ( 1 ) == 2 ) {
         cout << "Player 2 wins!" << endl;
     }
     else {
@@ -11,15 +11,18 @@
 template<std::size_t NumRows = 6, std::size_t NumCols = 7>
 class ConnectFourState {
     public:
-    using Move  = int;
-    using Moves = sax::compact_vector<Move, std::int64_t, NumCols, NumCols>;
-    using Board = ma::MatrixCM<char, NumRows, NumCols>;
+    using Move       = int;
+    using Moves      = sax::compact_vector<Move, std::int64_t, NumCols, NumCols>;
+    using Board      = ma::MatrixCM<char, NumRows, NumCols>;
+    using value_type = int; // The players, 1 and 2.
 
     using ZobristHash     = std::uint64_t;
     using ZobristHashKeys = ma::Cube<ZobristHash, 2, NumRows, NumCols, 1>; // 2 players, 1 based.
 
     ConnectFourState ( ) noexcept : player_to_move ( 1 ), board ( player_markers[ 0 ] ), last_col ( -1 ), last_row ( -1 ) {}
 
+    value_type playerToMove ( ) const noexcept { return player_to_move; }
+
     // Returns the hash of the board xor'ed with the player's hash.
     // For outside consumption.
     ZobristHash zobrist ( ) const noexcept {
@@ -73,6 +76,13 @@ class ConnectFourState {
         }
     }
 
+    // Plays random moves until the game is over.
+    void simulate ( ) {
+        static thread_local sax::Rng engine ( 4711 );
+        while ( has_moves ( ) )
+            do_random_move ( &engine );
+    }
+
     bool has_moves ( ) const {
         char winner = get_winner ( );
         if ( winner != player_markers[ 0 ] )
@@ -157,22 +167,24 @@ class ConnectFourState {
     private:
     template<typename Stream>
     void print ( Stream & out ) const noexcept {
-        out << endl;
+        out << std::endl;
         out << " ";
         for ( int col = 0; col < NumCols - 1; ++col )
             out << col << ' ';
-        out << NumCols - 1 << endl;
+        out << NumCols - 1 << std::endl;
         for ( int row = 0; row < NumRows; ++row ) {
             out << "|";
             for ( int col = 0; col < NumCols - 1; ++col )
                 out << board ( row, col ) << ' ';
-            out << board ( row, NumCols - 1 ) << "|" << endl;
+            out << board ( row, NumCols - 1 ) << "|" << std::endl;
         }
         out << "+";
         for ( int col = 0; col < NumCols - 1; ++col )
             out << "--";
-        out << "-+" << endl;
-        out << player_markers[ player_to_move ] << " to move " << endl << std::hex << zobrist ( ) << std::dec << endl << endl;
+        out << "-+" << std::endl;
+        out << player_markers[ player_to_move ] << " to move " << std::endl
+            << std::hex << zobrist ( ) << std::dec << std::endl
+            << std::endl;
     }
 
     ZobristHash m_zobrist_hash = m_zobrist_player_keys[ 0 ]; // Hash of the current m_board, irrespective of who played last.
@@ -0,0 +1,34 @@
+// Builds an opening book for Connect Four.
+//
+//     connect_four_book [depth [iterations [file]]]
+//
+// Searches every position up to depth moves into the game (default 4) with
+// iterations games per thread (default 1'000'000) and writes the book to file
+// (default connect_four.book), where connect_four picks it up.
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+
+#include <book_builder.h>
+#include <mcts.h>
+
+#include "connect_four.h"
+
+int main ( int argc, char * argv[] ) {
+    try {
+        int const depth        = argc > 1 ? std::atoi ( argv[ 1 ] ) : 4;
+        std::string const path = argc > 3 ? argv[ 3 ] : "connect_four.book";
+        Mcts::ComputeOptions options;
+        options.max_iterations    = argc > 2 ? std::atoi ( argv[ 2 ] ) : 1'000'000;
+        options.number_of_threads = static_cast<int> ( std::thread::hardware_concurrency ( ) );
+        auto const entries        = Mcts::build_opening_book ( ConnectFourState<6, 7> ( ), depth, options );
+        Mcts::write_opening_book ( path, entries );
+        std::cerr << entries.size ( ) << " moves written to " << path << "." << std::endl;
+    }
+    catch ( std::exception & error ) {
+        std::cerr << "ERROR: " << error.what ( ) << std::endl;
+        return 1;
+    }
+}
@@ -41,14 +41,14 @@ class GoApp: public AppBasic
 
 	enum PlayerType {HUMAN, COMPUTER};
 	PlayerType player1, player2;
-	MCTS::ComputeOptions player1_options, player2_options;
+	Mcts::ComputeOptions player1_options, player2_options;
 
 	enum GameStatus {WAITING_FOR_USER, COMPUTER_THINKING, GAME_OVER, GAME_ERROR};
 	GameStatus game_status;
 	std::string error_string;
 
 	// Compute move.
-	std::future<State::Move> computed_move;
+	std::unique_ptr<Mcts::SearchHandle<State>> search;
 	void next_player();
 	void start_compute_move();
 	void check_for_computed_move();
@@ -96,7 +96,7 @@ void GoApp::start_compute_move()
 
 	game_status = COMPUTER_THINKING;
 
-	MCTS::ComputeOptions options;
+	Mcts::ComputeOptions options;
 	if (state.player_to_move == 1) {
 		options = player1_options;
 	}
@@ -104,20 +104,8 @@ void GoApp::start_compute_move()
 		options = player2_options;
 	}
 
-	auto state_copy = state;
-	computed_move = 
-		std::async(std::launch::async,
-			[state_copy, options]() 
-			{ 
-				auto best_move = MCTS::compute_move(state_copy, options);
-				return best_move;
-
-				//// Single-threaded.
-				//auto tree = MCTS::compute_tree(state_copy, options, 1241 * std::time(0));
-				//typedef MCTS::Node<State> Node;
-				//auto best_child = *std::max_element( tree->children.begin(), tree->children.end(), [](Node* lhs, Node* rhs) { return lhs->visits < rhs->visits; } );
-				//return best_child->move;
-			});
+	// Runs in the background, the app polls it in update().
+	search.reset(new Mcts::SearchHandle<State>(state, options));
 }
 
 void GoApp::check_for_computed_move()
@@ -128,10 +116,10 @@ void GoApp::check_for_computed_move()
 		return;
 	}
 
-	auto status = computed_move.wait_for(std::chrono::seconds(0));
-	if (status == std::future_status::ready) {
+	if (search->done()) {
 		try {
-			auto move = computed_move.get();
+			auto move = search->best_move();
+			search.reset();
 			state.do_move(move);
 
 			// Are there any more moves possible?
@@ -208,7 +196,14 @@ void GoApp::keyDown( KeyEvent event )
 			start_compute_move();
 		}
 	}
+	else if (event.getChar() == 's') {
+		// Play the best move found so far.
+		if (game_status == COMPUTER_THINKING) {
+			search->stop();
+		}
+	}
 	else if (event.getChar() == 'r') {
+		search.reset();
 		state = State();
 		setup();
 	}
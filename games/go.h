@@ -2,7 +2,9 @@
 // petter.strandmark@gmail.com
 
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <random>
 #include <utility>
 
 #include <mcts.h>
@@ -27,9 +29,28 @@ public:
 	mutable int depth;
 	int player_to_move;
 	typedef int Move;
+	typedef sax::compact_vector<Move, std::int32_t, M * N + 1, M * N + 1> Moves;
+	typedef std::uint64_t ZobristHash;
+	typedef int value_type;
 	static const Move no_move;
 	static const Move pass;
 
+	int playerToMove() const
+	{
+		return player_to_move;
+	}
+
+	// The position is the board and the player to move.
+	ZobristHash zobrist() const
+	{
+		ZobristHash hash = player_to_move;
+		for (int i = 0; i < M; ++i) {
+		for (int j = 0; j < N; ++j) {
+			hash = 0x100000001b3ull * hash + board[i][j];
+		}}
+		return hash * 0x9e3779b97f4a7c15ull;
+	}
+
 	static int ij_to_ind(int i, int j)
 	{
 		attest(i >= 0 && j >= 0 && i < M && j < N);
@@ -48,13 +69,13 @@ public:
 		depth(0),
 		player_to_move(1)
 	{ 
-		all_hash_values.insert(compute_hash_value());
-
 		for (int i = 0; i < M; ++i) {
 			for (int j = 0; j < N; ++j) {
 				board[i][j] =  empty;
 			}
 		}
+
+		all_hash_values.insert(compute_hash_value());
 	}
 
 	GoState(char board[M][N+1]):
@@ -295,15 +316,24 @@ public:
 		do_move(move);
 	}
 
+	// Plays random moves until the game is over.
+	void simulate()
+	{
+		static thread_local std::mt19937_64 engine(4711);
+		while (has_moves()) {
+			do_random_move(&engine);
+		}
+	}
+
 	virtual bool has_moves() const
 	{
 		// TODO: make faster.
 		return ! get_moves().empty();
 	}
 
-	virtual std::vector<Move> get_moves() const
+	virtual Moves get_moves() const
 	{
-		std::vector<Move> moves;
+		Moves moves;
 		if (depth > 1000) {
 			attest(false);
 			return moves;
@@ -345,13 +375,15 @@ public:
 		return score;
 	}
 
-	virtual double get_result(int current_player_to_move) const
+	// In half points: 2 if the player who moved before current_player_to_move
+	// has the higher score, 1 for a draw and 0 otherwise.
+	virtual int get_result(int current_player_to_move) const
 	{
 		int score1 = get_player_score(1);
 		int score2 = get_player_score(2);
 
 		if (score1 == score2) {
-			return 0.5;
+			return 1;
 		}
 		int winner = 0;
 		if (score1 > score2) {
@@ -362,10 +394,10 @@ public:
 		}
 
 		if (winner == current_player_to_move) {
-			return 0.0;
+			return 0;
 		}
 		else {
-			return 1.0;
+			return 2;
 		}
 	}
 
@@ -19,7 +19,7 @@ void main_program()
 	// Set this to true to play against the computer.
 	bool human_player = true;
 
-	MCTS::ComputeOptions player1_options, player2_options;
+	Mcts::ComputeOptions player1_options, player2_options;
 	player1_options.max_iterations = -1;
 	player1_options.max_time = 1.0;
 	player1_options.verbose = true;
@@ -27,8 +27,13 @@ void main_program()
 	player2_options.max_time = 0.5;
 	player2_options.verbose = true;
 
+	// Player 1 thinks on the human's time as well, the trees are kept between moves.
+	Mcts::ComputeOptions ponder_options = player1_options;
+	ponder_options.max_time = 30.0;
+
 	typedef KalahaState<6> State;
 	State state(3);
+	Mcts::Search<State> player1, player2;
 
 	stringstream move_string;
 
@@ -38,11 +43,12 @@ void main_program()
 
 		State::Move move = State::no_move;
 		if (state.player_to_move == 1) {
-			move = MCTS::compute_move(state, player1_options);
+			move = player1.compute_move(state, player1_options);
 			state.do_move(move);
 		}
 		else {
 			if (human_player) {
+				player1.ponder(state, ponder_options);
 				while (true) {
 					cout << "Input your move: ";
 					move = State::no_move;
@@ -57,7 +63,7 @@ void main_program()
 				}
 			}
 			else {
-				move = MCTS::compute_move(state, player2_options);
+				move = player2.compute_move(state, player2_options);
 				state.do_move(move);
 			}
 		}
@@ -78,10 +84,10 @@ void main_program()
 	state.collect_seeds();
 	cout << endl << "Final state:\n" << state << endl;
 
-	if (state.get_result(2) > 0.5) {
+	if (state.get_result(2) > 1) {
 		cout << "Player 1 wins!" << endl;
 	}
-	else if (state.get_result(1) > 0.5) {
+	else if (state.get_result(1) > 1) {
 		cout << "Player 2 wins!" << endl;
 	}
 	else {
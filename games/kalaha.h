@@ -2,7 +2,9 @@
 // petter.strandmark@gmail.com
 
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <random>
 using namespace std;
 
 #include <mcts.h>
@@ -12,7 +14,10 @@ class KalahaState
 {
 public:
 	typedef short Move;
-	static const Move no_move   = -100;
+	typedef sax::compact_vector<Move, std::int32_t, num_bins, num_bins> Moves;
+	typedef std::uint64_t ZobristHash;
+	typedef int value_type;
+	static constexpr Move no_move = -100;
 	// I have no idea why GCC 4.8 does not allow initialization of
 	// pass_move here. Linking fails.
 	static const Move pass_move;
@@ -31,6 +36,27 @@ public:
 		}
 	}
 
+	int playerToMove() const
+	{
+		return player_to_move;
+	}
+
+	// The position is the bins, the stores, the player to move and whether
+	// that player has to pass.
+	ZobristHash zobrist() const
+	{
+		ZobristHash hash = 2 * player_to_move + player_must_pass;
+		for (auto seed: player1_bins) {
+			hash = 0x100000001b3ull * hash + seed;
+		}
+		for (auto seed: player2_bins) {
+			hash = 0x100000001b3ull * hash + seed;
+		}
+		hash = 0x100000001b3ull * hash + player1_store;
+		hash = 0x100000001b3ull * hash + player2_store;
+		return hash * 0x9e3779b97f4a7c15ull;
+	}
+
 	void do_move(Move move)
 	{
 		if (player_must_pass) {
@@ -110,6 +136,15 @@ public:
 		}
 	}
 
+	// Plays random moves until the game is over.
+	void simulate()
+	{
+		static thread_local std::mt19937_64 engine(4711);
+		while (has_moves()) {
+			do_random_move(&engine);
+		}
+	}
+
 	bool has_moves() const
 	{
 		if (player_must_pass) {
@@ -125,9 +160,9 @@ public:
 		return false;
 	}
 
-	std::vector<Move> get_moves() const
+	Moves get_moves() const
 	{
-		std::vector<Move> moves;
+		Moves moves;
 
 		if (player_must_pass) {
 			moves.push_back(pass_move);
@@ -143,7 +178,9 @@ public:
 		return moves;
 	}
 
-	double get_result(int current_player_to_move) const
+	// In half points: 2 if the player who moved before current_player_to_move
+	// has the most seeds, 1 for a draw and 0 otherwise.
+	int get_result(int current_player_to_move) const
 	{
 		short player1_sum = player1_store;
 		for (auto seed: player1_bins) {
@@ -156,21 +193,14 @@ public:
 		}
 
 		if (player1_sum == player2_sum) {
-			return 0.5;
+			return 1;
 		}
 
-		// Win amount is in [0.0, 0.5]
-		double win_amount = 0.5 * abs(double(player1_sum - player2_sum)) / (player1_sum + player2_sum);
-		double win  = 0.5 + win_amount;
-		double lose = 0.5 - win_amount;
-		//win = 1.0;
-		//lose = 0.0;
-
 		if (player1_sum > player2_sum) {
-			return current_player_to_move == 1 ? lose : win;
+			return current_player_to_move == 1 ? 0 : 2;
 		}
 		else {
-			return current_player_to_move == 1 ? win : lose;
+			return current_player_to_move == 1 ? 2 : 0;
 		}
 	}
 
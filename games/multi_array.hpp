@@ -31,6 +31,7 @@
 #include <algorithm>
 #include <array>
 #include <type_traits>
+#include <utility>
 
 namespace ma {
 
@@ -77,13 +78,14 @@ class alignas ( sizeof ( T ) * I > 32 ? 64 : sizeof ( T ) ) Vector {
         std::fill ( begin ( ), end ( ), value_ );
     }
 
-    [[nodiscard]] constexpr std::enable_if_t<std::is_copy_assignable<T>::value, Vector &> operator= ( Vector const & rhs_ ) {
+    constexpr std::enable_if_t<std::is_copy_assignable<T>::value, Vector &> operator= ( Vector const & rhs_ ) {
         if constexpr ( std::is_arithmetic<T>::value ) {
             std::memcpy ( &*begin ( ), &*rhs_.begin ( ), sizeof ( *this ) );
         }
         else {
             std::copy ( rhs_.begin ( ), rhs_.end ( ), begin ( ) );
         }
+        return *this;
     }
     [[nodiscard]] constexpr Vector & operator= ( Vector && ) noexcept = delete;
 
@@ -190,13 +192,14 @@ class alignas ( sizeof ( T ) * I * J > 32 ? 64 : sizeof ( T ) ) Matrix {
         std::fill ( begin ( ), end ( ), value_ );
     }
 
-    [[nodiscard]] constexpr std::enable_if_t<std::is_copy_assignable<T>::value, Matrix &> operator= ( Matrix const & rhs_ ) {
+    constexpr std::enable_if_t<std::is_copy_assignable<T>::value, Matrix &> operator= ( Matrix const & rhs_ ) {
         if constexpr ( std::is_arithmetic<T>::value ) {
             std::memcpy ( &*begin ( ), &*rhs_.begin ( ), sizeof ( *this ) );
         }
         else {
             std::copy ( rhs_.begin ( ), rhs_.end ( ), begin ( ) );
         }
+        return *this;
     }
     [[nodiscard]] constexpr Matrix & operator= ( Matrix && ) noexcept = delete;
 
@@ -340,13 +343,14 @@ class alignas ( sizeof ( T ) * I * J * K > 32 ? 64 : sizeof ( T ) ) Cube {
         std::fill ( begin ( ), end ( ), value_ );
     }
 
-    [[nodiscard]] constexpr std::enable_if_t<std::is_copy_assignable<T>::value, Cube &> operator= ( Cube const & rhs_ ) {
+    constexpr std::enable_if_t<std::is_copy_assignable<T>::value, Cube &> operator= ( Cube const & rhs_ ) {
         if constexpr ( std::is_arithmetic<T>::value ) {
             std::memcpy ( &*begin ( ), &*rhs_.begin ( ), sizeof ( *this ) );
         }
         else {
             std::copy ( rhs_.begin ( ), rhs_.end ( ), begin ( ) );
         }
+        return *this;
     }
     [[nodiscard]] constexpr Cube & operator= ( Cube && ) noexcept = delete;
 
@@ -476,13 +480,14 @@ class alignas ( sizeof ( T ) * I * J * K * L > 32 ? 64 : sizeof ( T ) ) HyperCub
         std::fill ( begin ( ), end ( ), value_ );
     }
 
-    [[nodiscard]] constexpr std::enable_if_t<std::is_copy_assignable<T>::value, HyperCube &> operator= ( HyperCube const & rhs_ ) {
+    constexpr std::enable_if_t<std::is_copy_assignable<T>::value, HyperCube &> operator= ( HyperCube const & rhs_ ) {
         if constexpr ( std::is_arithmetic<T>::value ) {
             std::memcpy ( &*begin ( ), &*rhs_.begin ( ), sizeof ( *this ) );
         }
         else {
             std::copy ( rhs_.begin ( ), rhs_.end ( ), begin ( ) );
         }
+        return *this;
     }
     [[nodiscard]] constexpr HyperCube & operator= ( HyperCube && ) noexcept = delete;
 
@@ -13,7 +13,7 @@ int main()
 {
 	using namespace std;
 
-	MCTS::ComputeOptions player1_options, player2_options;
+	Mcts::ComputeOptions player1_options, player2_options;
 	player1_options.max_iterations = 100000;
 	player1_options.verbose = true;
 	player2_options.max_iterations =  10000;
@@ -24,19 +24,19 @@ int main()
 		cout << "State: " << state.player_to_move << endl;
 		NimState::Move move;
 		if (state.player_to_move == 1) {
-			move = MCTS::compute_move(state, player1_options);
+			move = Mcts::compute_move(state, player1_options);
 		}
 		else {
-			move = MCTS::compute_move(state, player2_options);
+			move = Mcts::compute_move(state, player2_options);
 		}
 
 		cout << "Best move: " << move << endl;
 		state.do_move(move);
 	}
-	if (state.get_result(2) == 1.0) {
+	if (state.get_result(2) == 2) {
 		cout << "Player 1 wins!" << endl;
 	}
-	else if (state.get_result(1) == 1.0) {
+	else if (state.get_result(1) == 2) {
 		cout << "Player 2 wins!" << endl;
 	}
 	else {
@@ -2,7 +2,9 @@
 // petter.strandmark@gmail.com
 
 #include <algorithm>
+#include <cstdint>
 #include <iostream>
+#include <random>
 using namespace std;
 
 #include <mcts.h>
@@ -11,13 +13,27 @@ class NimState
 {
 public:
 	typedef int Move;
-	static const Move no_move = -1;
+	typedef sax::compact_vector<Move, std::int32_t, 3, 3> Moves;
+	typedef std::uint64_t ZobristHash;
+	typedef int value_type;
+	static constexpr Move no_move = -1;
 
 	NimState(int chips_ = 17)
 		: player_to_move(1),
 	      chips(chips_)
 	{ }
 
+	int playerToMove() const
+	{
+		return player_to_move;
+	}
+
+	// The position is the number of chips and the player to move.
+	ZobristHash zobrist() const
+	{
+		return (static_cast<ZobristHash>(chips) * 2 + player_to_move) * 0x9e3779b97f4a7c15ull;
+	}
+
 	void do_move(Move move)
 	{
 		attest(move >= 1 && move <= 3);
@@ -42,37 +58,61 @@ public:
 		check_invariant();
 	}
 
+	// Plays random moves until the game is over, the moves are appended to
+	// played (for RAVE).
+	void simulate(std::vector<Move>& played)
+	{
+		static thread_local std::mt19937_64 engine(4711);
+		while (has_moves()) {
+			int const before = chips;
+			do_random_move(&engine);
+			played.push_back(before - chips);
+		}
+	}
+
+	// Returns the number of moves played.
+	int simulate()
+	{
+		static thread_local std::vector<Move> played;
+		played.clear();
+		simulate(played);
+		return static_cast<int>(played.size());
+	}
+
 	bool has_moves() const
 	{
 		check_invariant();
 		return chips > 0;
 	}
 
-	std::vector<Move> get_moves() const
+	Moves get_moves() const
 	{
 		check_invariant();
 
-		std::vector<Move> moves;
+		Moves moves;
 		for (Move move = 1; move <= std::min(3, chips); ++move) {
 			moves.push_back(move);
 		}
 		return moves;
 	}
 
-	double get_result(int current_player_to_move) const
+	// In half points: 2 if the player who moved before current_player_to_move
+	// took the last chip (and won), 0 otherwise.
+	int get_result(int current_player_to_move) const
 	{
 		attest(chips == 0);
 		check_invariant();
 
 		if (player_to_move == current_player_to_move) {
-			return 1.0;
+			return 2;
 		}
 		else {
-			return 0.0;
+			return 0;
 		}
 	}
 
 	int player_to_move;
+	int chips;
 private:
 
 	void check_invariant() const
@@ -80,6 +120,4 @@ private:
 		attest(chips >= 0);
 		attest(player_to_move == 1 || player_to_move == 2);
 	}
-
-	int chips;
 };
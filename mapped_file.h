@@ -0,0 +1,105 @@
+//
+// MIT License.
+//
+// degski 2020
+// degski@gmail.com
+//
+// A file mapped read-only into memory (mmap, or MapViewOfFile on Windows).
+// Used for the tree files and the opening books, which are used in place.
+//
+
+#pragma once
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#if defined( _WIN32 )
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+namespace Mcts {
+
+class MappedFile {
+
+    public:
+    MappedFile ( ) noexcept = default;
+    // Throws std::runtime_error if path_ can't be mapped (or is empty).
+    explicit MappedFile ( std::string const & path_ );
+    MappedFile ( MappedFile && other_ ) noexcept :
+        address ( std::exchange ( other_.address, nullptr ) ), length ( std::exchange ( other_.length, 0 ) ) {}
+    MappedFile & operator= ( MappedFile && other_ ) noexcept {
+        unmap ( );
+        address = std::exchange ( other_.address, nullptr );
+        length  = std::exchange ( other_.length, 0 );
+        return *this;
+    }
+    MappedFile ( MappedFile const & ) = delete;
+    MappedFile & operator= ( MappedFile const & ) = delete;
+    ~MappedFile ( ) noexcept { unmap ( ); }
+
+    char const * data ( ) const noexcept { return static_cast<char const *> ( address ); }
+    std::size_t size ( ) const noexcept { return length; }
+    bool empty ( ) const noexcept { return not address; }
+
+    private:
+    void unmap ( ) noexcept;
+
+    void * address     = nullptr;
+    std::size_t length = 0;
+};
+
+inline MappedFile::MappedFile ( std::string const & path_ ) {
+#if defined( _WIN32 )
+    HANDLE file = CreateFileA ( path_.c_str ( ), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr );
+    if ( file != INVALID_HANDLE_VALUE ) {
+        LARGE_INTEGER size;
+        if ( GetFileSizeEx ( file, &size ) and size.QuadPart > 0 ) {
+            if ( HANDLE mapping = CreateFileMappingA ( file, nullptr, PAGE_READONLY, 0, 0, nullptr ) ) {
+                address = MapViewOfFile ( mapping, FILE_MAP_READ, 0, 0, 0 );
+                length  = address ? static_cast<std::size_t> ( size.QuadPart ) : 0;
+                CloseHandle ( mapping );
+            }
+        }
+        CloseHandle ( file );
+    }
+#else
+    int const file = ::open ( path_.c_str ( ), O_RDONLY );
+    if ( file >= 0 ) {
+        struct stat status;
+        if ( ::fstat ( file, &status ) == 0 and status.st_size > 0 ) {
+            void * const mapped = ::mmap ( nullptr, static_cast<std::size_t> ( status.st_size ), PROT_READ, MAP_SHARED, file, 0 );
+            if ( mapped != MAP_FAILED ) {
+                address = mapped;
+                length  = static_cast<std::size_t> ( status.st_size );
+            }
+        }
+        ::close ( file );
+    }
+#endif
+    if ( not address )
+        throw std::runtime_error ( "cannot map " + path_ );
+}
+
+inline void MappedFile::unmap ( ) noexcept {
+    if ( address ) {
+#if defined( _WIN32 )
+        UnmapViewOfFile ( address );
+#else
+        ::munmap ( address, length );
+#endif
+    }
+    address = nullptr;
+    length  = 0;
+}
+
+} // namespace Mcts
@@ -12,7 +12,9 @@
 //
 // Originally based on Python code at http://mcts.ai/code/python.html
 //
-// Uses the "root parallelization" technique [1].
+// Uses the "root parallelization" technique [1], or alternatively "tree
+// parallelization" with virtual loss [1], in which all threads grow a single
+// shared tree.
 //
 // This game engine can play any game defined by a state like this:
 //
@@ -35,6 +37,10 @@
 //
 //     int player_to_move;
 //
+//     // Optional, for RAVE: plays out the game, appending the moves to played.
+//     void simulate(std::vector<Move>& played);
+//     // simulate() may return the number of moves it played, for the profile.
+//
 //     // ...
 // private:
 //     // ...
@@ -54,45 +60,130 @@
 #pragma once
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cmath>
+#include <deque>
 #include <cstdlib>
 #include <future>
 #include <iomanip>
 #include <iostream>
+#include <limits>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <random>
 #include <set>
 #include <sstream>
 #include <string>
 #include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include <sax/prng_sfc.hpp>
 #include <sax/uniform_int_distribution.hpp>
 
 #include "../compact_vector/include/compact_vector.hpp"
-#include "../MCTSSearchTree/include/flat_search_tree_hash.hpp"
 
-#define USE_FSTH 0
+#include "evaluator.h"
+#include "node_allocation.h"
+#include "opening_book.h"
+#include "profile.h"
+#include "thread_pool.h"
+#include "transposition_table.h"
+#include "uct.h"
 
 namespace Mcts {
 
+enum class Parallelization {
+    root, // Every thread grows its own tree, the root children are merged afterwards.
+    tree  // All threads grow one shared tree, using virtual loss to spread them out.
+};
+
 struct ComputeOptions {
 
     int number_of_threads;
     int max_iterations;
     float max_time;
+    float time_tolerance; // Seconds max_time may be overrun by, the clock is read accordingly.
     bool verbose;
+    Parallelization parallelization;
+    int virtual_loss;    // Visits added to a node while a thread is below it (tree parallelization only).
+    bool transpositions; // Transpositions share one node (needs ArenaAllocation).
+    // The size of the transposition table the trees share in root-parallel mode, 0 is
+    // no table.
+    std::size_t transposition_table_bytes;
+    // The search stops as soon as this is set, may be nullptr.
+    std::atomic<bool> const * stop;
+    // Progressive widening: a node with n visits has at most widening_constant *
+    // n^widening_exponent children (at least one), the other moves wait. 0 is off,
+    // every move is tried before the children are selected from.
+    float widening_constant;
+    float widening_exponent;
+    // RAVE: the win rates of the children are blended with their all-moves-as-first
+    // win rates, the AMAF statistics weigh as much as this many visits (about). 0 is
+    // off. Needs State::simulate ( std::vector<Move> & ), see records_playouts.
+    float rave_equivalence;
+    // MCTS-Solver: terminal positions are proven wins, losses or draws, the proofs are
+    // propagated up the tree, proven children are no longer selected and the search
+    // stops as soon as the root is proven.
+    bool solver;
+    // The memory the trees of a search may take, about, 0 is no limit. Once it is used
+    // up, the trees stop growing and the search keeps simulating from their leaves, and
+    // from the nodes that would have tried a move (so that their untried moves keep
+    // counting).
+    std::size_t max_memory_bytes;
+    // Consulted before searching, a position in the book is answered from it. May be
+    // nullptr.
+    OpeningBook const * book;
+    // When the root moves are merged, each is valued against its most visited reply
+    // (merged over the trees as well) instead of by its own average.
+    bool merge_grandchildren;
+    // PUCT: with an evaluator (a PriorEvaluator<State>), the children are selected by
+    // Q + puct_constant * P * sqrt ( N ) / ( 1 + n ), P the prior of the move, and the
+    // untried moves are tried in order of prior. The leaves are evaluated in batches
+    // of evaluator_batch_size, with virtual loss spreading the iterations of a batch.
+    // May be nullptr, then UCT selects and the untried moves are picked at random.
+    PriorEvaluatorBase * evaluator;
+    float puct_constant;
+    int evaluator_batch_size;
+    // The times of the phases of the search, and what it did, are added to this, see
+    // profile.h. May be nullptr.
+    SearchProfile * profile;
 
     ComputeOptions ( ) :
         number_of_threads ( 4 ), max_iterations ( 1'000'000 ), max_time ( -1.0 ), // default is no time limit.
-        verbose ( true ) {}
+        time_tolerance ( 0.001f ), verbose ( true ), parallelization ( Parallelization::root ), virtual_loss ( 3 ),
+        transpositions ( false ), transposition_table_bytes ( 0 ), stop ( nullptr ), widening_constant ( 0.0f ),
+        widening_exponent ( 0.5f ), rave_equivalence ( 0.0f ), solver ( false ),
+        max_memory_bytes ( 0 ), book ( nullptr ), merge_grandchildren ( false ), evaluator ( nullptr ), puct_constant ( 1.5f ),
+        evaluator_batch_size ( 8 ), profile ( nullptr ) {}
 };
 
-template<typename State>
+struct DefaultPolicies;
+
+template<typename State, typename Allocation = HeapAllocation, typename Policies = DefaultPolicies>
 typename State::Move compute_move ( State const root_state, const ComputeOptions options = ComputeOptions ( ) );
 
+// True if State can report the moves of a playout, appending them to a vector, which
+// is what RAVE needs. The players must alternate.
+template<typename State, typename = void>
+struct records_playouts : std::false_type {};
+template<typename State>
+struct records_playouts<
+    State, std::void_t<decltype ( std::declval<State &> ( ).simulate ( std::declval<std::vector<typename State::Move> &> ( ) ) )>>
+    : std::true_type {};
+
+// True if State::simulate ( ) returns the number of moves it played, the playout
+// length of the profile.
+template<typename State, typename = void>
+struct counts_playouts : std::false_type {};
+template<typename State>
+struct counts_playouts<State, std::enable_if_t<std::is_integral<decltype ( std::declval<State &> ( ).simulate ( ) )>::value>>
+    : std::true_type {};
+
 static void check ( bool expr, char const * message );
 static void assertion_failed ( char const * expr, char const * file, int line );
 
@@ -109,46 +200,95 @@ static void assertion_failed ( char const * expr, char const * file, int line );
 #    define dattest( expr ) ( ( void ) 0 )
 #endif
 
-template<typename State>
-class Arc {};
+// A copyable atomic, all operations use relaxed ordering. The node statistics are
+// heuristics, so they don't need to be ordered with respect to anything else.
+template<typename T>
+class RelaxedAtomic {
 
-// This class is used to build the game tree. The root is created by the users and
-// the rest of the tree is created by add_node.
-template<typename State>
+    public:
+    RelaxedAtomic ( T value_ = T{ } ) noexcept : value ( value_ ) {}
+    RelaxedAtomic ( RelaxedAtomic const & other_ ) noexcept : value ( other_.load ( ) ) {}
+
+    RelaxedAtomic & operator= ( RelaxedAtomic const & other_ ) noexcept {
+        value.store ( other_.load ( ), std::memory_order_relaxed );
+        return *this;
+    }
+    RelaxedAtomic & operator= ( T value_ ) noexcept {
+        value.store ( value_, std::memory_order_relaxed );
+        return *this;
+    }
+
+    operator T ( ) const noexcept { return load ( ); }
+    T load ( ) const noexcept { return value.load ( std::memory_order_relaxed ); }
+
+    // Returns the new value.
+    T operator+= ( T delta_ ) noexcept {
+        if constexpr ( std::is_integral<T>::value ) {
+            return value.fetch_add ( delta_, std::memory_order_relaxed ) + delta_;
+        }
+        else {
+            T expected = value.load ( std::memory_order_relaxed );
+            while ( not value.compare_exchange_weak ( expected, expected + delta_, std::memory_order_relaxed ) )
+                ;
+            return expected + delta_;
+        }
+    }
+
+    private:
+    std::atomic<T> value;
+};
+
+// Guards the children and the untried moves of a node in tree-parallel mode. Copies
+// start out unlocked.
+class SpinLock {
+
+    public:
+    SpinLock ( ) noexcept = default;
+    SpinLock ( SpinLock const & ) noexcept {}
+    SpinLock & operator= ( SpinLock const & ) noexcept { return *this; }
+
+    void lock ( ) noexcept {
+        while ( flag.test_and_set ( std::memory_order_acquire ) )
+            std::this_thread::yield ( );
+    }
+    void unlock ( ) noexcept { flag.clear ( std::memory_order_release ); }
+
+    private:
+    std::atomic_flag flag = ATOMIC_FLAG_INIT;
+};
+
+// The game theoretic value of a node, for the player who moved into it, as proven by
+// the solver [Winands, Bjornsson & Saito 2008]. none until it is proven.
+enum class Proof : std::int8_t { none, win, loss, draw };
+
+// This class is used to build the game tree. The root is created by a Tree and
+// the rest of the tree is created by add_child. Where the nodes come from is up to
+// the Allocation policy, see node_allocation.h.
+template<typename State, typename Allocation = HeapAllocation>
 class Node {
 
+    friend Allocation;
+
     public:
     using Move            = typename State::Move;
-    using Moves           = typename State::Moves;
+    using Moves           = typename Allocation::template MoveList<typename State::Moves>;
     using Player          = typename State::value_type;
     using moves_size_type = typename Moves::size_type;
-    using Children        = sax::compact_vector<std::unique_ptr<Node>>;
+    using Children        = typename Allocation::template Children<Node>;
+    using Child           = typename Children::value_type;
+    using ChildVisits     = typename Allocation::template Array<RelaxedAtomic<std::int32_t>>;
+    using ChildWins       = typename Allocation::template Array<RelaxedAtomic<float>>;
+    using ChildMoves      = typename Allocation::template Array<Move>;
+    using Priors          = typename Allocation::template Array<float>;
     using ZobristHash     = typename State::ZobristHash;
+    using Arena           = typename Allocation::Arena;
 
-#if USE_FSTH
-    Node ( State const & state ) :
-        player_to_move ( state.player_to_move ), visits ( 0 ), wins ( 0 ), moves ( state.get_moves ( ) ), UCT_score ( 0.0f ),
-        hash ( state.zobrist ( ) ), move ( State::no_move ) {}
-
-    Node ( State const & state, Move const & move_ ) :
-        player_to_move ( state.player_to_move ), visits ( 0 ), wins ( 0 ), moves ( state.get_moves ( ) ), UCT_score ( 0.0f ),
-        hash ( state.zobrist ( ) ), move ( move_ ) {}
-#else
-    Node ( State const & state ) :
-        parent ( nullptr ), player_to_move ( state.playerToMove ( ) ), visits ( 0 ), wins ( 0 ), moves ( state.get_moves ( ) ),
-        UCT_score ( 0.0f ), hash ( state.zobrist ( ) ), move ( State::no_move ) {}
+    Node ( State const & state, Arena & arena ) : Node ( state, State::no_move, nullptr, 0, arena ) {}
 
     private:
-    Node ( State const & state, Move const & move_, Node * parent_ ) :
-        parent ( parent_ ), player_to_move ( state.playerToMove ( ) ), visits ( 0 ), wins ( 0 ), moves ( state.get_moves ( ) ),
-        UCT_score ( 0.0f ), hash ( state.zobrist ( ) ), move ( move_ ) {}
-#endif
-
-#if USE_FSTH
-
-#else
-
-#endif
+    Node ( State const & state, Move const & move_, Node * parent_, std::int32_t index_, Arena & arena ) :
+        parent ( parent_ ), player_to_move ( state.playerToMove ( ) ), visits ( 0 ),
+        moves ( Allocation::make_moves ( state.get_moves ( ), arena ) ), index ( index_ ), hash ( state.zobrist ( ) ), move ( move_ ) {}
 
     public:
     Node ( Node const & )            = default;
@@ -158,61 +298,137 @@ class Node {
     [[maybe_unused]] Node & operator= ( Node && ) noexcept = default;
 
     bool has_untried_moves ( ) const noexcept;
+    // True if a move should be tried before selecting from the children, see
+    // ComputeOptions::widening_constant.
+    bool may_expand ( float widening_constant, float widening_exponent ) const noexcept {
+        if ( not has_untried_moves ( ) )
+            return false;
+        if ( widening_constant <= 0.0f or children.empty ( ) )
+            return true;
+        return static_cast<float> ( children.size ( ) ) <
+               widening_constant * std::pow ( static_cast<float> ( visits ), widening_exponent );
+    }
     template<typename RandomEngine>
     // The move is removed.
     Move get_untried_move ( RandomEngine * engine ) noexcept;
+    // The untried move with the highest prior, see set_priors. The move is removed.
+    Move take_untried_move ( float & prior_ ) noexcept;
     Node * best_child ( ) const noexcept;
 
     bool has_children ( ) const noexcept { return not children.empty ( ); }
 
-    Node * select_child_UCT ( ) const noexcept;
-    Node * add_child ( Move const & move, State const & state );
-    void update ( int result );
+    // Returns the slot (in children) of the child with the highest UCT score.
+    std::int32_t select_child ( ) const noexcept;
+    // As above, but the statistics of the children found in table (if any) override
+    // the statistics of this tree, and with rave_equivalence > 0 the win rates are
+    // blended with the AMAF win rates. With solver, proven children are passed over,
+    // -1 is returned if all children are proven. visits_ and wins_ are scratch space.
+    std::int32_t select_child ( TranspositionTable<ZobristHash> const * table, float rave_equivalence, bool solver,
+                                std::vector<std::int32_t> & visits_, std::vector<float> & wins_ ) const;
+    Node * select_child_UCT ( ) const noexcept { return &*children[ select_child ( ) ]; }
+    // PUCT, see ComputeOptions::evaluator. The untried move with the highest prior
+    // competes with the children, unless expand is false. Unvisited moves are valued
+    // at the average of this node. Returns the slot of the child, children.size ( ) if
+    // the untried move is to be tried, or -1 if all children are proven (with solver)
+    // and there is nothing to try.
+    std::int32_t select_puct ( float puct_constant, bool solver, bool expand ) const noexcept;
+    // Takes the priors of the moves of this node: first those of the children, in the
+    // order of the children, then those of the untried moves, in the order of moves.
+    // The untried moves are reordered by prior.
+    void set_priors ( float const * priors, Arena & arena );
+    bool has_priors ( ) const noexcept { return evaluated; }
+    // The prior of an untried move, uniform before the node has been evaluated.
+    float untried_prior ( ) const noexcept {
+        return evaluated ? move_priors.back ( ) : 1.0f / static_cast<float> ( children.size ( ) + moves.size ( ) );
+    }
+    // With amaf, the node keeps AMAF statistics for its children, if it did so from
+    // its first expansion. A prior of 0 or more is kept for PUCT, if the node did so
+    // from its first expansion as well.
+    Node * add_child ( Move const & move, State const & state, Arena & arena, bool amaf = false, float prior = -1.0f );
+    // Adds a node that is already in the tree (a transposition) as a child, and
+    // returns its slot. The statistics of the new edge are seeded from the children
+    // of child.
+    std::int32_t link_child ( Move const & move, Node * child, Arena & arena, bool amaf = false, float prior = -1.0f );
+    bool has_amaf ( ) const noexcept { return not children.empty ( ) and amaf_visits.size ( ) == children.size ( ); }
+    // Counts an AMAF visit to the child in slot, see has_amaf.
+    void update_amaf ( std::int32_t slot, int result ) noexcept {
+        amaf_visits[ slot ] += 1;
+        amaf_wins[ slot ] += static_cast<float> ( result );
+    }
+    // Takes the child reached by move out of the tree, or returns nullptr.
+    Child detach_child ( Move const & move );
+    // Counts a visit to the child in slot, with the result for the player who moved
+    // into it, and takes off the virtual loss that was added when it was selected.
+    void update_child ( std::int32_t slot, int result, int virtual_loss = 0 ) noexcept {
+        child_visits[ slot ] += 1 - virtual_loss;
+        child_wins[ slot ] += static_cast<float> ( result );
+    }
+    void add_virtual_loss ( std::int32_t slot, int virtual_loss ) noexcept { child_visits[ slot ] += virtual_loss; }
+
+    // Returns the proof of this node that follows from the proofs of its children: a
+    // loss if a child is a proven win, else a win (or a draw) if all moves have been
+    // tried and proven. In tree-parallel mode, the caller holds the lock.
+    Proof solve ( ) const noexcept;
+    bool is_proven ( ) const noexcept { return proof.load ( ) != Proof::none; }
+    bool is_terminal ( ) const noexcept { return children.empty ( ) and not has_untried_moves ( ); }
+
+    // The memory this node takes, about: the node and the arrays it holds.
+    std::size_t bytes ( ) const noexcept {
+        std::size_t const per_child = sizeof ( Child ) + sizeof ( typename ChildVisits::value_type ) +
+                                      sizeof ( typename ChildWins::value_type ) + sizeof ( Move );
+        std::size_t const per_amaf = sizeof ( typename ChildVisits::value_type ) + sizeof ( typename ChildWins::value_type );
+        return sizeof ( Node ) + moves.capacity ( ) * sizeof ( Move ) + children.capacity ( ) * per_child +
+               amaf_visits.capacity ( ) * per_amaf + ( child_priors.capacity ( ) + move_priors.capacity ( ) ) * sizeof ( float );
+    }
+
+    // The wins of this node, as kept by the parent.
+    float wins ( ) const noexcept { return parent ? static_cast<float> ( parent->child_wins[ index ] ) : 0.0f; }
 
     std::string to_string ( ) const;
     std::string tree_to_string ( int max_depth = 1'000'000, int indent = 0 ) const;
 
-#if not USE_FSTH
-    Node * parent; // 8
-#endif
-    Player player_to_move; // 12
-    int visits;            // 16
-    float wins;            // 20
-    Moves moves;           // 28
-#if not USE_FSTH
-    Children children; // 36
-#endif
+    Node * parent; // The first parent if this node is shared by transpositions.
+    Player player_to_move;
+    RelaxedAtomic<int> visits;
+    Moves moves;
+    // The statistics of the children, in the same order as the children. Stored
+    // here, contiguously, so that selection runs over flat arrays. With
+    // transpositions these are the statistics of the edges, child_moves holds the
+    // moves of the edges (the move of a shared child is the move of its first edge).
+    Children children;
+    ChildVisits child_visits;
+    ChildWins child_wins;
+    ChildMoves child_moves;
+    // All-moves-as-first statistics of the children, RAVE only (empty otherwise).
+    ChildVisits amaf_visits;
+    ChildWins amaf_wins;
+    // The priors of the children and of the untried moves (in the same order), PUCT only.
+    Priors child_priors;
+    Priors move_priors;
+    mutable SpinLock lock;      // Only taken in tree-parallel mode.
+    RelaxedAtomic<Proof> proof; // Solver only.
+    bool evaluated = false;     // The priors are set, PUCT only.
+    std::int32_t index;         // In the (first) parent's children.
 
     private:
     std::string indent_string ( int indent ) const;
-
-    float UCT_score; // 40
+    // Sizes the arrays of the children on the first expansion.
+    void reserve_children ( Arena & arena, bool amaf, bool priors );
+    void add_statistics ( Move const & move, std::int32_t visits_, float wins_, bool amaf, float prior );
 
     public:
-    /*
-    [[nodiscard]] static void * operator new ( std::size_t n_size_ ) {
-        if ( auto ptr = mi_malloc ( n_size_ ) )
-            return ptr;
-        else {
-            std::cout << "malloc err\n";
-            throw std::bad_alloc{ };
-        }
-    }
-
-    static void operator delete ( void * ptr_ ) noexcept { mi_free ( ptr_ ); }
-    */
-    ZobristHash hash; // 48
-    Move move;        // 50
+    ZobristHash hash;
+    Move move;
 };
 
-template<typename State>
-bool Node<State>::has_untried_moves ( ) const noexcept {
+template<typename State, typename Allocation>
+bool Node<State, Allocation>::has_untried_moves ( ) const noexcept {
     return not moves.is_released ( );
 }
 
-template<typename State>
+template<typename State, typename Allocation>
 template<typename RandomEngine>
-typename State::Move Node<State>::get_untried_move ( RandomEngine * engine ) noexcept {
+typename State::Move Node<State, Allocation>::get_untried_move ( RandomEngine * engine ) noexcept {
     attest ( not moves.empty ( ) );
     if ( 1 == moves.size ( ) ) {
         Move m = moves.front ( );
@@ -222,242 +438,1476 @@ typename State::Move Node<State>::get_untried_move ( RandomEngine * engine ) noe
     return moves.unordered_erase ( sax::uniform_int_distribution<moves_size_type> ( 0, moves.size ( ) - 1 ) ( *engine ) );
 }
 
-template<typename State>
-Node<State> * Node<State>::best_child ( ) const noexcept {
+template<typename State, typename Allocation>
+typename State::Move Node<State, Allocation>::take_untried_move ( float & prior_ ) noexcept {
+    attest ( not moves.empty ( ) and evaluated );
+    Move const m = moves.back ( );
+    prior_       = move_priors.back ( );
+    if ( 1 == moves.size ( ) ) {
+        moves.reset ( );
+        move_priors.reset ( );
+    }
+    else {
+        moves.pop_back ( );
+        move_priors.pop_back ( );
+    }
+    return m;
+}
+
+template<typename State, typename Allocation>
+Node<State, Allocation> * Node<State, Allocation>::best_child ( ) const noexcept {
     attest ( moves.empty ( ) );
     attest ( not children.empty ( ) );
-    return std::max_element ( children.begin ( ), children.end ( ),
-                              [] ( auto & a, auto & b ) noexcept { return a->visits < b->visits; } )
-        ->get ( );
+    return &*children[ std::max_element ( child_visits.begin ( ), child_visits.end ( ),
+                                          [] ( auto & a, auto & b ) noexcept { return a < b; } ) -
+                       child_visits.begin ( ) ];
 }
 
-template<typename State>
-Node<State> * Node<State>::select_child_UCT ( ) const noexcept {
+template<typename State, typename Allocation>
+std::int32_t Node<State, Allocation>::select_child ( ) const noexcept {
+    static_assert ( sizeof ( RelaxedAtomic<std::int32_t> ) == sizeof ( std::int32_t ) and
+                        sizeof ( RelaxedAtomic<float> ) == sizeof ( float ),
+                    "the UCT kernel reads the statistics as plain arrays" );
     attest ( not children.empty ( ) );
-    for ( auto & child : children )
-        child->UCT_score =
-            ( static_cast<double> ( child->wins ) / 2.0 ) / static_cast<double> ( child->visits ) +
-            std::sqrt ( 2.0 * std::log ( static_cast<double> ( this->visits ) ) / static_cast<double> ( child->visits ) );
-    return std::max_element ( children.begin ( ), children.end ( ),
-                              [] ( auto & a, auto & b ) { return a->UCT_score < b->UCT_score; } )
-        ->get ( );
+    // In tree-parallel mode other threads update the statistics while they are read,
+    // the scores are heuristics anyway.
+    return select_uct ( reinterpret_cast<std::int32_t const *> ( child_visits.data ( ) ),
+                        reinterpret_cast<float const *> ( child_wins.data ( ) ), static_cast<int> ( children.size ( ) ), visits );
 }
 
-#if USE_FSTH
-template<typename State>
-NodeID Node<State>::add_child ( Move const & move, State const & state ) {
-    return children.emplace_back ( new Node{ state, move, this } ).get ( );
+template<typename State, typename Allocation>
+std::int32_t Node<State, Allocation>::select_child ( TranspositionTable<ZobristHash> const * table, float rave_equivalence,
+                                                     bool solver, std::vector<std::int32_t> & visits_,
+                                                     std::vector<float> & wins_ ) const {
+    attest ( not children.empty ( ) );
+    std::size_t const n = children.size ( );
+    bool const rave     = rave_equivalence > 0.0f and has_amaf ( );
+    visits_.resize ( n );
+    wins_.resize ( n );
+    std::int32_t parent_visits = 0;
+    std::size_t proven         = 0;
+    for ( std::size_t i = 0; i < n; ++i ) {
+        visits_[ i ] = child_visits[ i ];
+        wins_[ i ]   = child_wins[ i ];
+        // The table holds the games of all trees, unless it had no room for them.
+        if ( table ) {
+            if ( auto entry = table->find ( children[ i ]->hash ) ) {
+                std::int32_t const v = entry->visits.load ( std::memory_order_relaxed );
+                if ( v > visits_[ i ] ) {
+                    visits_[ i ] = v;
+                    wins_[ i ]   = static_cast<float> ( entry->wins.load ( std::memory_order_relaxed ) );
+                }
+            }
+        }
+        // beta = sqrt ( k / ( 3 n + k ) ) [Gelly & Silver 2007], the kernel divides the
+        // wins by the visits again.
+        if ( rave and visits_[ i ] > 0 ) {
+            if ( std::int32_t const amaf_n = amaf_visits[ i ]; amaf_n > 0 ) {
+                float const beta = std::sqrt ( rave_equivalence / ( 3.0f * visits_[ i ] + rave_equivalence ) );
+                wins_[ i ]       = ( 1.0f - beta ) * wins_[ i ] + beta * visits_[ i ] * amaf_wins[ i ] / amaf_n;
+            }
+        }
+        parent_visits += visits_[ i ];
+        // Nothing is learned from a proven child, it scores below any other child.
+        if ( solver and children[ i ]->is_proven ( ) ) {
+            visits_[ i ] = 1;
+            wins_[ i ]   = -std::numeric_limits<float>::max ( );
+            ++proven;
+        }
+    }
+    if ( proven == n )
+        return -1;
+    return select_uct ( visits_.data ( ), wins_.data ( ), static_cast<int> ( n ), parent_visits );
 }
-#else
-template<typename State>
-Node<State> * Node<State>::add_child ( Move const & move, State const & state ) {
-    return children.emplace_back ( new Node{ state, move, this } ).get ( );
+
+template<typename State, typename Allocation>
+std::int32_t Node<State, Allocation>::select_puct ( float puct_constant, bool solver, bool expand ) const noexcept {
+    std::int32_t const n = static_cast<std::int32_t> ( children.size ( ) );
+    bool const priors    = child_priors.size ( ) == children.size ( );
+    // First play urgency: an unvisited move is valued at the average of the tried moves.
+    std::int32_t parent_visits = 0;
+    float parent_wins          = 0.0f;
+    for ( std::int32_t i = 0; i < n; ++i ) {
+        parent_visits += child_visits[ i ];
+        parent_wins += child_wins[ i ];
+    }
+    float const unvisited = parent_visits > 0 ? parent_wins / ( 2.0f * parent_visits ) : 0.5f;
+    float const scale     = puct_constant * std::sqrt ( static_cast<float> ( std::max ( parent_visits, 1 ) ) );
+    float const uniform   = 1.0f / static_cast<float> ( n + moves.size ( ) );
+    std::int32_t best     = -1;
+    float best_score      = -std::numeric_limits<float>::max ( );
+    for ( std::int32_t i = 0; i < n; ++i ) {
+        if ( solver and children[ i ]->is_proven ( ) )
+            continue;
+        std::int32_t const v = child_visits[ i ];
+        float const q        = v > 0 ? child_wins[ i ] / ( 2.0f * v ) : unvisited;
+        float const score    = q + scale * ( priors ? child_priors[ i ] : uniform ) / ( 1 + v );
+        if ( score > best_score ) {
+            best_score = score;
+            best       = i;
+        }
+    }
+    if ( expand and has_untried_moves ( ) and unvisited + scale * untried_prior ( ) > best_score )
+        best = n;
+    return best;
 }
-#endif
 
-template<typename State>
-void Node<State>::update ( int result ) {
-    visits++;
-    wins += result;
+template<typename State, typename Allocation>
+void Node<State, Allocation>::set_priors ( float const * priors, Arena & arena ) {
+    std::size_t const n = children.size ( );
+    for ( std::size_t i = 0; i < n and i < child_priors.size ( ); ++i )
+        child_priors[ i ] = priors[ i ];
+    if ( has_untried_moves ( ) ) {
+        // Sorted by prior, ascending, the best move is taken from the back.
+        static thread_local std::vector<std::pair<float, Move>> order;
+        order.clear ( );
+        for ( std::size_t i = 0; i < static_cast<std::size_t> ( moves.size ( ) ); ++i )
+            order.emplace_back ( priors[ n + i ], moves[ i ] );
+        std::stable_sort ( order.begin ( ), order.end ( ),
+                           [] ( auto const & a, auto const & b ) noexcept { return a.first < b.first; } );
+        move_priors = Allocation::template make_array<Priors> ( order.size ( ), arena );
+        Allocation::reserve ( move_priors, order.size ( ), arena );
+        for ( std::size_t i = 0; i < order.size ( ); ++i ) {
+            moves[ i ] = order[ i ].second;
+            move_priors.emplace_back ( order[ i ].first );
+        }
+    }
+    evaluated = true;
 }
 
-template<typename State>
-std::string Node<State>::to_string ( ) const {
+template<typename State, typename Allocation>
+Proof Node<State, Allocation>::solve ( ) const noexcept {
+    bool all_proven = not has_untried_moves ( ), draw = false;
+    for ( auto & child : children ) {
+        switch ( child->proof.load ( ) ) {
+            case Proof::win: return Proof::loss; // The player to move here wins.
+            case Proof::draw: draw = true; break;
+            case Proof::none: all_proven = false; break;
+            case Proof::loss: break;
+        }
+    }
+    if ( not all_proven or children.empty ( ) )
+        return Proof::none;
+    return draw ? Proof::draw : Proof::win;
+}
+
+template<typename State, typename Allocation>
+void Node<State, Allocation>::reserve_children ( Arena & arena, bool amaf, bool priors ) {
+    // The move being expanded has been taken from moves already.
+    std::size_t const capacity = 1 + moves.size ( );
+    Allocation::reserve ( children, capacity, arena );
+    Allocation::reserve ( child_visits, capacity, arena );
+    Allocation::reserve ( child_wins, capacity, arena );
+    Allocation::reserve ( child_moves, capacity, arena );
+    if ( amaf ) {
+        amaf_visits = Allocation::template make_array<ChildVisits> ( capacity, arena );
+        amaf_wins   = Allocation::template make_array<ChildWins> ( capacity, arena );
+        Allocation::reserve ( amaf_visits, capacity, arena );
+        Allocation::reserve ( amaf_wins, capacity, arena );
+    }
+    if ( priors ) {
+        child_priors = Allocation::template make_array<Priors> ( capacity, arena );
+        Allocation::reserve ( child_priors, capacity, arena );
+    }
+}
+
+template<typename State, typename Allocation>
+void Node<State, Allocation>::add_statistics ( Move const & move, std::int32_t visits_, float wins_, bool amaf, float prior ) {
+    if ( amaf and amaf_visits.size ( ) == children.size ( ) ) {
+        amaf_visits.emplace_back ( 0 );
+        amaf_wins.emplace_back ( 0.0f );
+    }
+    if ( prior >= 0.0f and child_priors.size ( ) == children.size ( ) )
+        child_priors.emplace_back ( prior );
+    child_visits.emplace_back ( visits_ );
+    child_wins.emplace_back ( wins_ );
+    child_moves.emplace_back ( move );
+}
+
+// In tree-parallel mode, the caller holds the lock. No reallocations happen after
+// the first child is added, so the statistics can be updated without the lock.
+template<typename State, typename Allocation>
+Node<State, Allocation> * Node<State, Allocation>::add_child ( Move const & move, State const & state, Arena & arena, bool amaf,
+                                                               float prior ) {
+    if ( children.empty ( ) )
+        reserve_children ( arena, amaf, prior >= 0.0f );
+    add_statistics ( move, 0, 0.0f, amaf, prior );
+    auto const i = static_cast<std::int32_t> ( children.size ( ) );
+    return &*children.emplace_back ( Allocation::template make<Node> ( arena, state, move, this, i, arena ) );
+}
+
+template<typename State, typename Allocation>
+typename Node<State, Allocation>::Child Node<State, Allocation>::detach_child ( Move const & move_ ) {
+    for ( std::int32_t i = 0, n = static_cast<std::int32_t> ( children.size ( ) ); i < n; ++i ) {
+        if ( child_moves[ i ] == move_ ) {
+            Child detached = std::move ( children[ i ] );
+            // The last child takes its place.
+            children[ i ]     = std::move ( children.back ( ) );
+            child_visits[ i ] = child_visits.back ( );
+            child_wins[ i ]   = child_wins.back ( );
+            child_moves[ i ]  = child_moves.back ( );
+            if ( has_amaf ( ) ) {
+                amaf_visits[ i ] = amaf_visits.back ( );
+                amaf_wins[ i ]   = amaf_wins.back ( );
+                amaf_visits.pop_back ( );
+                amaf_wins.pop_back ( );
+            }
+            if ( child_priors.size ( ) == children.size ( ) ) {
+                child_priors[ i ] = child_priors.back ( );
+                child_priors.pop_back ( );
+            }
+            if ( children[ i ] )
+                children[ i ]->index = i;
+            children.pop_back ( );
+            child_visits.pop_back ( );
+            child_wins.pop_back ( );
+            child_moves.pop_back ( );
+            detached->parent = nullptr;
+            detached->index  = 0;
+            return detached;
+        }
+    }
+    return nullptr;
+}
+
+template<typename State, typename Allocation>
+std::int32_t Node<State, Allocation>::link_child ( Move const & move, Node * child, Arena & arena, bool amaf, float prior ) {
+    if ( children.empty ( ) )
+        reserve_children ( arena, amaf, prior >= 0.0f );
+    // What the children of child won, the player who moves into child lost.
+    std::int32_t n = 0;
+    float w        = 0.0f;
+    for ( std::size_t i = 0; i < child->children.size ( ); ++i ) {
+        n += child->child_visits[ i ];
+        w += child->child_wins[ i ];
+    }
+    add_statistics ( move, n, 2.0f * n - w, amaf, prior );
+    children.emplace_back ( child );
+    return static_cast<std::int32_t> ( children.size ( ) ) - 1;
+}
+
+template<typename State, typename Allocation>
+std::string Node<State, Allocation>::to_string ( ) const {
     std::stringstream ss;
     ss << "["
        << "P" << 3 - player_to_move << " "
        << "M:" << move << " "
-       << "W/V: " << ( static_cast<double> ( wins ) / 2.0 ) << "/" << visits << " "
+       << "W/V: " << ( static_cast<double> ( wins ( ) ) / 2.0 ) << "/" << visits << " "
        << "U: " << moves.size ( ) << "]\n";
     return ss.str ( );
 }
 
-template<typename State>
-std::string Node<State>::tree_to_string ( int max_depth, int indent ) const {
+template<typename State, typename Allocation>
+std::string Node<State, Allocation>::tree_to_string ( int max_depth, int indent ) const {
     if ( indent >= max_depth )
         return "";
     std::string s = indent_string ( indent ) + to_string ( );
-    for ( auto child : children )
+    for ( auto & child : children )
         s += child->tree_to_string ( max_depth, indent + 1 );
     return s;
 }
 
-template<typename State>
-std::string Node<State>::indent_string ( int indent ) const {
+template<typename State, typename Allocation>
+std::string Node<State, Allocation>::indent_string ( int indent ) const {
     std::string s = "";
     for ( int i = 1; i <= indent; ++i )
         s += "| ";
     return s;
 }
 
+// Maps positions (by Zobrist hash) to the nodes of a tree, so that transpositions
+// share one node. Turns the tree into a directed acyclic graph.
+template<typename Node>
+class Transpositions {
+
+    public:
+    using ZobristHash = typename Node::ZobristHash;
+
+    Node * find ( ZobristHash hash_ ) const {
+        std::lock_guard<std::mutex> guard ( mutex );
+        auto it = nodes.find ( hash_ );
+        return it != nodes.end ( ) ? it->second : nullptr;
+    }
+    // Returns the node that is now registered for hash_.
+    Node * insert ( ZobristHash hash_, Node * node_ ) {
+        std::lock_guard<std::mutex> guard ( mutex );
+        return nodes.emplace ( hash_, node_ ).first->second;
+    }
+    void clear ( ) noexcept { nodes.clear ( ); }
+    std::size_t size ( ) const noexcept { return nodes.size ( ); }
+
+    private:
+    mutable std::mutex mutex;
+    std::unordered_map<ZobristHash, Node *> nodes;
+};
+
+// A search tree: the root node and the arenas its nodes were allocated from, one
+// arena per thread that grows the tree. With transpositions enabled, the tree is a
+// DAG.
+template<typename State, typename Allocation = HeapAllocation>
+class Tree {
+
+    public:
+    using Node        = Mcts::Node<State, Allocation>;
+    using Arena       = typename Allocation::Arena;
+    using Move        = typename State::Move;
+    using ZobristHash = typename State::ZobristHash;
+
+    explicit Tree ( State const & root_state ) : arenas ( 1 ) {
+        root_node = typename Node::Child ( Allocation::template make<Node> ( arenas.front ( ), root_state, arenas.front ( ) ) );
+    }
+
+    Tree ( Tree && other_ ) noexcept :
+        arenas ( std::move ( other_.arenas ) ), root_node ( std::exchange ( other_.root_node, nullptr ) ),
+        dag ( std::move ( other_.dag ) ) {}
+    Tree & operator= ( Tree && other_ ) noexcept {
+        root_node = std::exchange ( other_.root_node, nullptr );
+        arenas    = std::move ( other_.arenas );
+        dag       = std::move ( other_.dag );
+        return *this;
+    }
+
+    Node * root ( ) const noexcept { return &*root_node; }
+
+    // Shares nodes between transpositions from now on. Only possible if the nodes are
+    // not owned by their parents.
+    void enable_transpositions ( ) {
+        check ( not Allocation::frees_nodes, "transpositions need an allocation policy that does not free nodes" );
+        if ( not dag ) {
+            dag.reset ( new Transpositions<Node> ( ) );
+            dag->insert ( root_node->hash, root ( ) );
+        }
+    }
+    // Returns nullptr if transpositions are not enabled.
+    Transpositions<Node> * transpositions ( ) const noexcept { return dag.get ( ); }
+
+    // Call before starting number_ threads on this tree.
+    void reserve_arenas ( std::size_t number_ ) {
+        while ( arenas.size ( ) < number_ )
+            arenas.emplace_back ( );
+    }
+    Arena & arena ( std::size_t i_ ) noexcept { return arenas[ i_ ]; }
+
+    // The memory taken by the nodes: the used part of the arenas, or with heap
+    // allocation (no arenas to ask) the memory of the nodes, which are counted.
+    std::size_t bytes ( ) const noexcept {
+        std::size_t n = 0;
+        if constexpr ( Allocation::frees_nodes ) {
+            std::vector<Node const *> stack ( 1, root ( ) );
+            while ( not stack.empty ( ) ) {
+                Node const * node = stack.back ( );
+                stack.pop_back ( );
+                n += node->bytes ( );
+                for ( auto & child : node->children )
+                    stack.push_back ( &*child );
+            }
+        }
+        else {
+            for ( auto & arena : arenas )
+                n += arena.used ( );
+        }
+        return n;
+    }
+
+    // Returns the root, a child or a grandchild with this hash, or nullptr.
+    Node * find ( ZobristHash hash_ ) const noexcept;
+
+    // Makes node_, which must be part of this tree, the new root. Everything that is
+    // not below node_ is freed.
+    void reroot ( Node * node_ );
+
+    private:
+    // Copies the subtree below node_ into arena_. Nodes that are shared by
+    // transpositions are copied once, the copies are registered in dag_.
+    static Node * clone ( Node const & node_, Node * parent_, Arena & arena_, Transpositions<Node> * dag_ );
+
+    std::deque<Arena> arenas;
+    typename Node::Child root_node;
+    std::unique_ptr<Transpositions<Node>> dag;
+};
+
+template<typename State, typename Allocation>
+typename Tree<State, Allocation>::Node * Tree<State, Allocation>::find ( ZobristHash hash_ ) const noexcept {
+    if ( root_node->hash == hash_ )
+        return root ( );
+    for ( auto & child : root_node->children ) {
+        if ( child->hash == hash_ )
+            return &*child;
+        for ( auto & grandchild : child->children )
+            if ( grandchild->hash == hash_ )
+                return &*grandchild;
+    }
+    return nullptr;
+}
+
+template<typename State, typename Allocation>
+void Tree<State, Allocation>::reroot ( Node * node_ ) {
+    if ( node_ == root ( ) )
+        return;
+    if constexpr ( Allocation::frees_nodes ) {
+        // The old root takes the siblings with it.
+        root_node = node_->parent->detach_child ( node_->move );
+    }
+    else {
+        // Copy what is kept into fresh arenas and drop the old ones, that frees the
+        // discarded siblings in one go.
+        std::deque<Arena> kept ( 1 );
+        std::unique_ptr<Transpositions<Node>> kept_dag ( dag ? new Transpositions<Node> ( ) : nullptr );
+        root_node = clone ( *node_, nullptr, kept.front ( ), kept_dag.get ( ) );
+        arenas    = std::move ( kept );
+        dag       = std::move ( kept_dag );
+    }
+}
+
+template<typename State, typename Allocation>
+typename Tree<State, Allocation>::Node * Tree<State, Allocation>::clone ( Node const & node_, Node * parent_, Arena & arena_,
+                                                                         Transpositions<Node> * dag_ ) {
+    if ( dag_ ) {
+        if ( Node * copy = dag_->find ( node_.hash ) )
+            return copy;
+    }
+    Node * copy        = Allocation::template make<Node> ( arena_, node_ );
+    if ( dag_ )
+        dag_->insert ( node_.hash, copy );
+    copy->parent       = parent_;
+    copy->moves        = typename Node::Moves ( node_.moves, arena_ );
+    copy->children     = typename Node::Children ( node_.children, arena_ );
+    copy->child_visits = typename Node::ChildVisits ( node_.child_visits, arena_ );
+    copy->child_wins   = typename Node::ChildWins ( node_.child_wins, arena_ );
+    copy->child_moves  = typename Node::ChildMoves ( node_.child_moves, arena_ );
+    copy->amaf_visits  = typename Node::ChildVisits ( node_.amaf_visits, arena_ );
+    copy->amaf_wins    = typename Node::ChildWins ( node_.amaf_wins, arena_ );
+    copy->child_priors = typename Node::Priors ( node_.child_priors, arena_ );
+    copy->move_priors  = typename Node::Priors ( node_.move_priors, arena_ );
+    for ( auto & child : copy->children )
+        child = clone ( *child, copy, arena_, dag_ );
+    return copy;
+}
+
 // Walltime.
 inline double wall_time ( ) noexcept {
     using Clock = std::chrono::high_resolution_clock;
     return double ( Clock::now ( ).time_since_epoch ( ).count ( ) ) * double ( Clock::period::num ) / double ( Clock::period::den );
 }
 
-template<typename State>
-std::unique_ptr<Node<State>> compute_tree ( State const root_state, ComputeOptions const options, sax::Rng::result_type seed_ ) {
-    static_assert ( std::is_copy_assignable<Node<State>>::value, "Node<State> is not copy-assignable" );
-    static_assert ( std::is_move_assignable<Node<State>>::value, "Node<State> is not move-assignable" );
-    sax::Rng random_engine ( seed_ );
-    attest ( options.max_iterations >= 0 or options.max_time >= 0 );
+// Tells a loop when to read the clock. Reading it every iteration costs a good part
+// of a cheap playout, so the clock is read every stride iterations, with the stride
+// adapted to the measured time per iteration such that the deadline is overrun by
+// at most about half the tolerance. The stride at most doubles per read, so a loop
+// that slows down is caught in time.
+class Deadline {
 
-#if USE_FSTH
-    using Dag    = fsth::SearchTree<Arc<State>, Node<State>>;
-    using NodeID = typename Dag::NodeID;
+    public:
+    Deadline ( double max_time_, double tolerance_ ) noexcept :
+        start ( wall_time ( ) ), last ( start ),
+        end ( max_time_ >= 0 ? start + max_time_ : std::numeric_limits<double>::infinity ( ) ),
+        tolerance ( tolerance_ > 0 ? tolerance_ : 0.001 ) {}
 
-    fsth::SearchTree<Arc<State>, Node<State>> dag ( root_state );
+    // Counts an iteration, returns true if the clock is due.
+    bool tick ( ) noexcept { return ++iterations >= stride; }
 
-    std::vector<NodeID> parents{ dag.root_node };
+    // Reads the clock and adapts the stride.
+    double now ( ) noexcept {
+        double const time = wall_time ( );
+        if ( iterations ) {
+            double const per_iteration = ( time - last ) / iterations;
+            double const target        = std::min ( 0.5 * tolerance, end - time );
+            std::int64_t const next =
+                per_iteration > 0 and target > 0 ? static_cast<std::int64_t> ( target / per_iteration ) : 2 * stride;
+            stride = std::clamp<std::int64_t> ( next, 1, 2 * stride );
+        }
+        last       = time;
+        iterations = 0;
+        return time;
+    }
 
-#else
-    auto root = std::unique_ptr<Node<State>> ( new Node<State> ( root_state ) );
-#endif
+    bool passed ( double time_ ) const noexcept { return time_ >= end; }
+    double start_time ( ) const noexcept { return start; }
 
-    double start_time = wall_time ( );
-    double print_time = start_time;
+    private:
+    double start, last, end, tolerance;
+    std::int64_t stride = 1, iterations = 0;
+};
 
-    for ( int iter = 1; iter <= options.max_iterations or options.max_iterations < 0; ++iter ) {
+// The memory the trees of a search may still take, shared by its jobs. Every
+// expansion is charged for, a job that finds it used up stops expanding.
+class MemoryBudget {
 
-#if USE_FSTH
-        parents.resize ( 1 );
-        NodeID node = dag.root_node;
-#else
-        auto node = root.get ( );
-#endif
+    public:
+    explicit MemoryBudget ( std::int64_t bytes_ ) noexcept : remaining ( bytes_ ) {}
 
-        State state = root_state;
+    bool exhausted ( ) const noexcept { return remaining.load ( ) <= 0; }
+    void charge ( std::int64_t bytes_ ) noexcept { remaining += -bytes_; }
 
-        // Select a path through the tree to a leaf node.
-#if USE_FSTH
-        while ( auto & node_ref = dag[ node ]; not node_ref.has_untried_moves ( ) and node_ref.has_children ( ) ) {
-            node = node_ref.select_child_UCT ( );
-            state.do_move ( node_ref.move );
-            parents.push_back ( node );
+    private:
+    RelaxedAtomic<std::int64_t> remaining;
+};
+
+// What the policies of a search get to see: the options, and what the search keeps
+// for them.
+template<typename State, typename Allocation>
+struct SearchContext {
+    ComputeOptions const & options;
+    TranspositionTable<typename State::ZobristHash> const * table;
+    PriorEvaluator<State> * evaluator;
+    bool rave;
+    bool full;   // The memory budget is used up, nothing is expanded.
+    bool record; // The moves of the playout go to played (RAVE).
+    // Scratch space of the selection.
+    std::vector<std::int32_t> visits;
+    std::vector<float> wins;
+    // The moves of the playout, if recorded.
+    std::vector<typename State::Move> played;
+    // The number of moves of the playout, if the playout policy knows it.
+    std::int64_t playout_length = 0;
+};
+
+// The policies of a search: a template argument of grow_tree (and of what calls it),
+// resolved at compile time, so that they are inlined into the search loop. A policy
+// set provides, as static member functions,
+//
+//   select:  the slot of the child of node_ to descend into, children.size ( ) to
+//            expand an untried move, or -1 if node_ is the leaf of this iteration;
+//   expand:  takes the untried move to try from node_ (and sets prior_ if the node
+//            keeps priors, see Node::add_child);
+//   playout: plays state_ to the end of the game (and sets playout_length of
+//            context_ if it can);
+//   backup:  counts the result of the game for the edge from parent_ (slot_) to
+//            child_, takes off virtual_loss_, and returns the result.
+//
+// In tree-parallel mode, select and expand are called with node_ locked. A set that
+// derives from DefaultPolicies only needs to provide the functions it replaces.
+struct DefaultPolicies {
+
+    // UCB1, with the table, RAVE and the solver as the options say, and progressive
+    // widening. PUCT with an evaluator, a node without priors is a leaf (until it has
+    // been evaluated with its batch). Without memory left, a node that would try a
+    // move is a leaf: a playout from it samples its untried moves as well, selecting
+    // from its children only would leave them out of its value.
+    template<typename State, typename Allocation>
+    static std::int32_t select ( Node<State, Allocation> const & node_, SearchContext<State, Allocation> & context_ ) {
+        auto const & options = context_.options;
+        auto const expand    = static_cast<std::int32_t> ( node_.children.size ( ) );
+        if ( context_.evaluator ) {
+            if ( not node_.has_priors ( ) )
+                return -1;
+            std::int32_t const slot = node_.select_puct ( options.puct_constant, options.solver, true );
+            return context_.full and slot == expand ? -1 : slot;
         }
-#else
-        while ( not node->has_untried_moves ( ) and node->has_children ( ) ) {
-            node = node->select_child_UCT ( );
-            state.do_move ( node->move );
+        if ( node_.may_expand ( options.widening_constant, options.widening_exponent ) )
+            return context_.full ? -1 : expand;
+        if ( not node_.has_children ( ) )
+            return -1;
+        std::int32_t const slot =
+            context_.table or context_.rave or options.solver
+                ? node_.select_child ( context_.table, options.rave_equivalence, options.solver, context_.visits, context_.wins )
+                : node_.select_child ( );
+        // All children are proven, only an untried move can still change the value of this node.
+        if ( slot < 0 )
+            return not context_.full and node_.has_untried_moves ( ) ? expand : -1;
+        return slot;
+    }
+
+    // In order of prior with PUCT, at random otherwise.
+    template<typename State, typename Allocation, typename RandomEngine>
+    static typename State::Move expand ( Node<State, Allocation> & node_, SearchContext<State, Allocation> & context_,
+                                         RandomEngine & random_engine_, float & prior_ ) {
+        return context_.evaluator ? node_.take_untried_move ( prior_ ) : node_.get_untried_move ( &random_engine_ );
+    }
+
+    // State::simulate, recording the moves if asked to.
+    template<typename State, typename Allocation>
+    static void playout ( State & state_, SearchContext<State, Allocation> & context_ ) {
+        if constexpr ( records_playouts<State>::value ) {
+            if ( context_.record ) {
+                context_.played.clear ( );
+                state_.simulate ( context_.played );
+                context_.playout_length = static_cast<std::int64_t> ( context_.played.size ( ) );
+                return;
+            }
         }
-#endif
-        // If we are not already at the final state, expand the
-        // tree with a new node and move there.
-#if USE_FSTH
-        if ( auto & node_ref = dag[ node ]; node_ref.has_untried_moves ( ) ) {
-            auto move = node_ref.get_untried_move ( &random_engine );
-            state.do_move ( move );
-            NodeID id = dag.contains ( state.zobrist ( ) ) )
-            if ( not id.value )
-                id = dag.addNode ( move, state );
-            dag.addArc ( node, id );
-            parents.push_back ( node = id );
+        if constexpr ( counts_playouts<State>::value )
+            context_.playout_length = static_cast<std::int64_t> ( state_.simulate ( ) );
+        else
+            state_.simulate ( );
+    }
+
+    // The result of the game for the player who moved into child_.
+    template<typename State, typename Allocation>
+    static int backup ( Node<State, Allocation> & parent_, std::int32_t slot_, Node<State, Allocation> & child_, State const & state_,
+                        int virtual_loss_ ) noexcept {
+        int const result = state_.get_result ( child_.player_to_move );
+        child_.visits += 1;
+        parent_.update_child ( slot_, result, virtual_loss_ );
+        return result;
+    }
+};
+
+// Runs the search iterations on an existing tree. With shared_ set, several threads may
+// grow the same tree concurrently: nodes are locked while their children are selected
+// or expanded and virtual loss is applied along the path. With transpositions_, an
+// expansion into a position that is already in the tree links to the existing node.
+// With table_, the statistics of the positions are pooled with other trees. With budget_,
+// the tree only grows while there is memory left. With options.evaluator, the children
+// are selected by PUCT and the iterations run in batches: the leaves of a batch are
+// evaluated in one call, before the playouts of the batch. Selection, expansion,
+// playout and backup are left to Policies. With options.profile, the phases are timed
+// and counted, and the thread adds its profile to it when done.
+template<typename State, typename Allocation, typename Policies = DefaultPolicies>
+void grow_tree ( Node<State, Allocation> * root, State const & root_state, ComputeOptions const & options,
+                 sax::Rng::result_type seed_, bool shared_, typename Allocation::Arena & arena_,
+                 Transpositions<Node<State, Allocation>> * transpositions_  = nullptr,
+                 TranspositionTable<typename State::ZobristHash> * table_ = nullptr, MemoryBudget * budget_ = nullptr ) {
+    using Node = Mcts::Node<State, Allocation>;
+    sax::Rng random_engine ( seed_ );
+    attest ( options.max_iterations >= 0 or options.max_time >= 0 or options.stop );
+    auto * const evaluator = dynamic_cast<PriorEvaluator<State> *> ( options.evaluator );
+    check ( not options.evaluator or evaluator, "the evaluator does not evaluate this State" );
+    // Virtual loss spreads the threads growing a shared tree, and the iterations of a batch.
+    int const virtual_loss = shared_ or evaluator ? options.virtual_loss : 0;
+    int const batch_size   = evaluator ? std::max ( 1, options.evaluator_batch_size ) : 1;
+
+    // The nodes visited in an iteration, with their slot in the previous node.
+    struct Step {
+        Node * node;
+        std::int32_t slot;
+    };
+    // An iteration of the batch, its path and the state at its leaf.
+    struct Descent {
+        std::vector<Step> path;
+        State state;
+    };
+    std::vector<Descent> batch;
+    // The leaves of the batch that have no priors yet.
+    LeafBatch<State> leaves;
+    std::vector<Node *> leaf_nodes;
+    bool const rave = options.rave_equivalence > 0.0f;
+    check ( not rave or records_playouts<State>::value, "RAVE needs State::simulate ( std::vector<Move> & )" );
+    check ( not rave or not evaluator, "RAVE blends into UCT, not into PUCT" );
+    SearchProfile profile;
+    PhaseClock clock ( options.profile ? &profile : nullptr );
+    // Nodes are measured for the budget, and for the profile.
+    bool const measure = budget_ or clock.on ( );
+    // The memory of the tree, as far as a change to node_ goes: with an arena what the
+    // arena of this thread has handed out (a node that lets go of its untried moves
+    // gives nothing back to the arena), as Tree::bytes counts it, else what node_
+    // takes (see Node::bytes).
+    auto footprint = [ &arena_ ] ( Node const * node_ ) -> std::int64_t {
+        if constexpr ( Allocation::frees_nodes )
+            return static_cast<std::int64_t> ( node_->bytes ( ) );
+        else
+            return static_cast<std::int64_t> ( arena_.used ( ) );
+    };
+    SearchContext<State, Allocation> context{ options, table_, evaluator, rave, false, rave, { }, { }, { } };
+    // RAVE: the moves made from a node on, by the player to move at the leaf (0) and by
+    // the other player (1).
+    std::vector<typename State::Move> playout_moves[ 2 ], tree_moves[ 2 ];
+    auto const & played = context.played;
+
+    bool const timed = options.verbose or options.max_time >= 0;
+    Deadline deadline ( options.max_time, options.time_tolerance );
+    double print_time = deadline.start_time ( );
+
+    clock.start ( );
+    bool stopped = false;
+    for ( int iter = 0; not stopped and ( iter < options.max_iterations or options.max_iterations < 0 ); ) {
+
+        int const batch_iterations = options.max_iterations < 0 ? batch_size : std::min ( batch_size, options.max_iterations - iter );
+        while ( batch.size ( ) < static_cast<std::size_t> ( batch_iterations ) )
+            batch.push_back ( Descent{ { }, root_state } );
+
+        for ( int b = 0; b < batch_iterations; ++b ) {
+
+            auto & path  = batch[ b ].path;
+            auto & state = batch[ b ].state;
+            auto node    = root;
+            state        = root_state;
+            path.assign ( 1, Step{ root, -1 } );
+            auto descend = [ & ] ( std::int32_t slot ) {
+                auto child = &*node->children[ slot ];
+                node->add_virtual_loss ( slot, virtual_loss );
+                state.do_move ( node->child_moves[ slot ] );
+                if ( shared_ ) {
+                    node->lock.unlock ( );
+                    child->lock.lock ( );
+                }
+                node = child;
+                path.push_back ( Step{ node, slot } );
+            };
+
+            if ( shared_ )
+                node->lock.lock ( );
+            // Select a path through the tree to a leaf node. Without memory left, nothing is
+            // expanded, see DefaultPolicies::select.
+            context.full = budget_ and budget_->exhausted ( );
+            bool expand  = false;
+            while ( true ) {
+                std::int32_t const slot = Policies::select ( *node, context );
+                if ( slot < 0 )
+                    break;
+                if ( slot == static_cast<std::int32_t> ( node->children.size ( ) ) ) {
+                    expand = true;
+                    break;
+                }
+                descend ( slot );
+            }
+            if ( clock.on ( ) )
+                profile.selection_depth += static_cast<std::int64_t> ( path.size ( ) - 1 );
+            clock.lap ( SearchProfile::selection );
+            // If we are not already at the final state, expand the
+            // tree with a new node and move there.
+            if ( expand ) {
+                std::int64_t const bytes_before = measure ? footprint ( node ) : 0;
+                float prior                     = -1.0f;
+                auto move                       = Policies::expand ( *node, context, random_engine, prior );
+                state.do_move ( move );
+                Node * child = nullptr;
+                if ( transpositions_ ) {
+                    child = transpositions_->find ( state.zobrist ( ) );
+                    // Never link back into the path, that would make a cycle (in games where
+                    // positions can repeat, the hash should include the move number).
+                    if ( child and
+                         std::any_of ( path.begin ( ), path.end ( ), [ child ] ( Step const & s ) { return s.node == child; } ) )
+                        child = nullptr;
+                }
+                // The root statistics may be read while the trees grow, see root_statistics.
+                bool const lock_root = not shared_ and node == root;
+                if ( lock_root )
+                    root->lock.lock ( );
+                std::int32_t slot;
+                std::int64_t child_bytes = 0; // A linked child is in the tree already, only the edge is new.
+                if ( child ) {
+                    // Lock order follows the order of play, positions don't repeat.
+                    if ( shared_ )
+                        child->lock.lock ( );
+                    slot = node->link_child ( move, child, arena_, rave, prior );
+                    if ( shared_ )
+                        child->lock.unlock ( );
+                }
+                else {
+                    child = node->add_child ( move, state, arena_, rave, prior );
+                    slot  = child->index;
+                    if ( measure and Allocation::frees_nodes )
+                        child_bytes = static_cast<std::int64_t> ( child->bytes ( ) );
+                    if ( clock.on ( ) )
+                        profile.nodes += 1;
+                    if ( transpositions_ )
+                        transpositions_->insert ( child->hash, child );
+                }
+                if ( lock_root )
+                    root->lock.unlock ( );
+                std::int64_t const bytes = measure ? footprint ( node ) - bytes_before + child_bytes : 0;
+                if ( budget_ )
+                    budget_->charge ( bytes );
+                if ( clock.on ( ) )
+                    profile.bytes += bytes;
+                node->add_virtual_loss ( slot, virtual_loss );
+                if ( shared_ )
+                    node->lock.unlock ( );
+                node = child;
+                path.push_back ( Step{ node, slot } );
+            }
+            else if ( shared_ ) {
+                node->lock.unlock ( );
+            }
+            clock.lap ( SearchProfile::expansion );
+
+            // The moves of a new leaf, those of its children first, see Node::set_priors.
+            if ( evaluator and not node->has_priors ( ) and not node->is_terminal ( ) and
+                 std::find ( leaf_nodes.begin ( ), leaf_nodes.end ( ), node ) == leaf_nodes.end ( ) ) {
+                if ( shared_ )
+                    node->lock.lock ( );
+                leaf_nodes.push_back ( node );
+                leaves.states.push_back ( state );
+                leaves.moves.insert ( leaves.moves.end ( ), node->child_moves.begin ( ), node->child_moves.end ( ) );
+                if ( node->has_untried_moves ( ) )
+                    leaves.moves.insert ( leaves.moves.end ( ), node->moves.begin ( ), node->moves.end ( ) );
+                leaves.offsets.push_back ( leaves.moves.size ( ) );
+                if ( shared_ )
+                    node->lock.unlock ( );
+                clock.lap ( SearchProfile::evaluation );
+            }
         }
-#else
-        if ( node->has_untried_moves ( ) ) {
-            auto move = node->get_untried_move ( &random_engine );
-            state.do_move ( move );
-            node = node->add_child ( move, state );
+
+        // Evaluate the new leaves, all at once.
+        if ( leaf_nodes.size ( ) ) {
+            leaves.priors.assign ( leaves.moves.size ( ), 0.0f );
+            evaluator->evaluate ( leaves );
+            for ( std::size_t i = 0; i < leaf_nodes.size ( ); ++i ) {
+                float * const priors = leaves.priors.data ( ) + leaves.offsets[ i ];
+                std::size_t const n  = leaves.offsets[ i + 1 ] - leaves.offsets[ i ];
+                float sum            = 0.0f;
+                for ( std::size_t m = 0; m < n; ++m )
+                    sum += priors[ m ] = std::max ( priors[ m ], 0.0f );
+                for ( std::size_t m = 0; m < n; ++m )
+                    priors[ m ] = sum > 0.0f ? priors[ m ] / sum : 1.0f / static_cast<float> ( n );
+                Node * const leaf = leaf_nodes[ i ];
+                if ( shared_ )
+                    leaf->lock.lock ( );
+                // Another thread may have been first.
+                if ( not leaf->has_priors ( ) ) {
+                    std::int64_t const bytes_before = measure ? footprint ( leaf ) : 0;
+                    leaf->set_priors ( priors, arena_ );
+                    std::int64_t const bytes = measure ? footprint ( leaf ) - bytes_before : 0;
+                    if ( budget_ )
+                        budget_->charge ( bytes );
+                    if ( clock.on ( ) )
+                        profile.bytes += bytes;
+                }
+                if ( shared_ )
+                    leaf->lock.unlock ( );
+            }
+            leaves.clear ( );
+            leaf_nodes.clear ( );
+            clock.lap ( SearchProfile::evaluation );
         }
-#endif
 
-        // We now play randomly until the game ends.
-        state.simulate ( );
+        // Every iteration of the batch is finished, also after the search was stopped, as
+        // the virtual loss has to come off.
+        for ( int b = 0; b < batch_iterations; ++b ) {
 
-        // We have now reached a final state. Backpropagate the result
-        // up the tree to the root node.
-#if USE_FSTH
-        auto const result = state.get_result ( dag[ node ].player_to_move );
-        std::for_each ( std::begin ( parents ), std::end ( parents ),
-                        [ result ] ( auto & n ) noexcept { dag[ n ].update ( result ); } );
-#else
-        while ( node ) {
-            node->update ( state.get_result ( node->player_to_move ) );
-            node = node->parent;
-        }
-#endif
-        if ( options.verbose or options.max_time >= 0 ) {
-            double time = wall_time ( );
-            if ( options.verbose && ( time - print_time >= 1.0 or iter == options.max_iterations ) ) {
-                std::cerr << iter << " games played (" << double ( iter ) / ( time - start_time ) << " / second)." << std::endl;
-                print_time = time;
+            ++iter;
+            auto & path  = batch[ b ].path;
+            auto & state = batch[ b ].state;
+
+            // We now play randomly until the game ends.
+            Policies::playout ( state, context );
+            if ( clock.on ( ) ) {
+                profile.iterations += 1;
+                profile.playout_moves += context.playout_length;
+            }
+            clock.lap ( SearchProfile::simulation );
+
+            // We have now reached a final state. Backpropagate the result
+            // up the path to the root node, removing the virtual loss.
+            for ( std::size_t i = path.size ( ) - 1; i > 0; --i ) {
+                int const result = Policies::backup ( *path[ i - 1 ].node, path[ i ].slot, *path[ i ].node, state, virtual_loss );
+                if ( table_ )
+                    table_->update ( path[ i ].node->hash, result );
             }
+            root->visits += 1;
+
+            // All moves as first: a child of a node on the path gets an AMAF visit if its
+            // move was made later on by the same player, in the tree or in the playout.
+            if ( rave ) {
+                auto const leaf_player = path.back ( ).node->player_to_move;
+                for ( int side = 0; side < 2; ++side ) {
+                    playout_moves[ side ].clear ( );
+                    tree_moves[ side ].clear ( );
+                    for ( std::size_t i = side; i < played.size ( ); i += 2 )
+                        playout_moves[ side ].push_back ( played[ i ] );
+                    std::sort ( playout_moves[ side ].begin ( ), playout_moves[ side ].end ( ) );
+                }
+                for ( std::size_t i = path.size ( ) - 1; i > 0; --i ) {
+                    Node * const parent = path[ i - 1 ].node;
+                    int const side      = parent->player_to_move == leaf_player ? 0 : 1;
+                    tree_moves[ side ].push_back ( parent->child_moves[ path[ i ].slot ] );
+                    int const result = state.get_result ( path[ i ].node->player_to_move );
+                    if ( shared_ )
+                        parent->lock.lock ( );
+                    if ( parent->has_amaf ( ) ) {
+                        for ( std::int32_t c = 0, n = static_cast<std::int32_t> ( parent->children.size ( ) ); c < n; ++c ) {
+                            auto const & move = parent->child_moves[ c ];
+                            if ( std::binary_search ( playout_moves[ side ].begin ( ), playout_moves[ side ].end ( ), move ) or
+                                 std::find ( tree_moves[ side ].begin ( ), tree_moves[ side ].end ( ), move ) !=
+                                     tree_moves[ side ].end ( ) )
+                                parent->update_amaf ( c, result );
+                        }
+                    }
+                    if ( shared_ )
+                        parent->lock.unlock ( );
+                }
+            }
+
+            // A terminal leaf is proven by the result. The proof is propagated up the path for
+            // as long as it proves the parent as well.
+            if ( options.solver ) {
+                Node * const leaf = path.back ( ).node;
+                if ( not leaf->is_proven ( ) and leaf->is_terminal ( ) ) {
+                    if ( path.size ( ) > 1 ) {
+                        // The results for the player who moved into the leaf and for the other player.
+                        auto const mover = state.get_result ( leaf->player_to_move );
+                        auto const other = state.get_result ( path[ path.size ( ) - 2 ].node->player_to_move );
+                        leaf->proof      = mover > other ? Proof::win : mover < other ? Proof::loss : Proof::draw;
+                    }
+                }
+                else if ( not leaf->is_proven ( ) ) {
+                    // With transpositions, the children of a node are also proven through its
+                    // other parents, it is a leaf once they all are.
+                    if ( shared_ )
+                        leaf->lock.lock ( );
+                    Proof const proof = leaf->solve ( );
+                    if ( shared_ )
+                        leaf->lock.unlock ( );
+                    if ( proof != Proof::none )
+                        leaf->proof = proof;
+                }
+                for ( std::size_t i = path.size ( ) - 1; i > 0 and path[ i ].node->is_proven ( ); --i ) {
+                    Node * const parent = path[ i - 1 ].node;
+                    if ( shared_ )
+                        parent->lock.lock ( );
+                    Proof const proof = parent->solve ( );
+                    if ( shared_ )
+                        parent->lock.unlock ( );
+                    if ( proof == Proof::none )
+                        break;
+                    parent->proof = proof;
+                }
+                // Nothing left to search.
+                if ( root->is_proven ( ) )
+                    stopped = true;
+            }
+
+            if ( options.stop and options.stop->load ( std::memory_order_relaxed ) )
+                stopped = true;
+            if ( timed and not stopped and ( deadline.tick ( ) or iter == options.max_iterations ) ) {
+                double const time = deadline.now ( );
+                if ( options.verbose && ( time - print_time >= 1.0 or iter == options.max_iterations ) ) {
+                    std::cerr << iter << " games played (" << double ( iter ) / ( time - deadline.start_time ( ) ) << " / second)."
+                              << std::endl;
+                    print_time = time;
+                }
 
-            if ( time - start_time >= options.max_time )
-                break;
+                if ( deadline.passed ( time ) )
+                    stopped = true;
+            }
+            clock.lap ( SearchProfile::backpropagation );
         }
     }
-    return root;
+    if ( clock.on ( ) ) {
+        clock.stop ( );
+        options.profile->add ( profile );
+    }
 }
 
-template<typename State>
+template<typename State, typename Allocation = HeapAllocation, typename Policies = DefaultPolicies>
+Tree<State, Allocation> compute_tree ( State const root_state, ComputeOptions const options, sax::Rng::result_type seed_ ) {
+    static_assert ( std::is_copy_assignable<Node<State, Allocation>>::value, "Node<State> is not copy-assignable" );
+    static_assert ( std::is_move_assignable<Node<State, Allocation>>::value, "Node<State> is not move-assignable" );
+    Tree<State, Allocation> tree ( root_state );
+    if ( options.transpositions )
+        tree.enable_transpositions ( );
+    std::unique_ptr<MemoryBudget> budget ( options.max_memory_bytes ? new MemoryBudget ( static_cast<std::int64_t> ( options.max_memory_bytes ) -
+                                                                                        static_cast<std::int64_t> ( tree.bytes ( ) ) )
+                                                                    : nullptr );
+    grow_tree<State, Allocation, Policies> ( tree.root ( ), root_state, options, seed_, false, tree.arena ( 0 ), tree.transpositions ( ),
+                                             nullptr, budget.get ( ) );
+    return tree;
+}
+
+// The trees of a search: one tree per thread with root parallelization, a single
+// shared tree with tree parallelization.
+template<typename State, typename Allocation = HeapAllocation>
+using Trees = std::vector<Tree<State, Allocation>>;
+
+// Owns the search threads, which are reused across moves and games. Keep one
+// engine around instead of paying for thread creation on every move. The
+// threads are pinned to cores as placement_ says. A search job may run on any
+// of them, so it binds its arena to the NUMA node of the thread that picked it
+// up, and the nodes it adds live in the memory of the socket that grows them.
+class Engine {
+
+    public:
+    explicit Engine ( int number_of_threads_ = 0, Placement placement_ = Placement::compact ) :
+        pool ( number_of_threads_, placement_ ) {}
+    Engine ( int number_of_threads_, bool pin_threads_ ) : pool ( number_of_threads_, pin_threads_ ) {}
+
+    template<typename State, typename Allocation = HeapAllocation, typename Policies = DefaultPolicies>
+    typename State::Move compute_move ( State const & root_state, ComputeOptions const & options = ComputeOptions ( ) );
+
+    // Grows the given trees (which may already hold statistics) on the pool. Missing
+    // trees are created from root_state. In root-parallel mode, the trees share table_
+    // if it is enabled.
+    template<typename State, typename Allocation, typename Policies = DefaultPolicies>
+    void grow ( Trees<State, Allocation> & trees, State const & root_state, ComputeOptions const & options,
+                sax::Rng::result_type seed_offset_ = 0, TranspositionTable<typename State::ZobristHash> * table_ = nullptr );
+
+    // Creates or drops trees to match options, as grow does first. Trees that are being
+    // read while they grow should be prepared up front.
+    template<typename State, typename Allocation>
+    static void prepare ( Trees<State, Allocation> & trees, State const & root_state, ComputeOptions const & options );
+
+    ThreadPool & thread_pool ( ) noexcept { return pool; }
+
+    private:
+    ThreadPool pool;
+};
+
+// The engine behind the free compute_move.
+inline Engine & default_engine ( ) {
+    static Engine engine;
+    return engine;
+}
+
+template<typename State, typename Allocation, typename Policies>
 typename State::Move compute_move ( State const root_state, ComputeOptions const options ) {
-    auto moves = root_state.get_moves ( );
-    attest ( moves.size ( ) > 0 );
-    if ( moves.size ( ) == 1 )
-        return moves[ 0 ];
-    double start_time = wall_time ( );
-    // Start all jobs to compute trees.
-    std::vector<std::future<std::unique_ptr<Node<State>>>> root_futures;
+    return default_engine ( ).compute_move<State, Allocation, Policies> ( root_state, options );
+}
+
+template<typename State, typename Allocation>
+void Engine::prepare ( Trees<State, Allocation> & trees, State const & root_state, ComputeOptions const & options ) {
+    bool const shared                 = options.parallelization == Parallelization::tree;
+    std::size_t const number_of_trees = shared ? 1 : options.number_of_threads;
+    while ( trees.size ( ) > number_of_trees )
+        trees.pop_back ( );
+    while ( trees.size ( ) < number_of_trees )
+        trees.emplace_back ( root_state );
+    if ( shared )
+        trees.front ( ).reserve_arenas ( options.number_of_threads );
+    if ( options.transpositions )
+        for ( auto & tree : trees )
+            tree.enable_transpositions ( );
+}
+
+template<typename State, typename Allocation, typename Policies>
+void Engine::grow ( Trees<State, Allocation> & trees, State const & root_state, ComputeOptions const & options,
+                    sax::Rng::result_type seed_offset_, TranspositionTable<typename State::ZobristHash> * table_ ) {
+    bool const shared = options.parallelization == Parallelization::tree;
+    prepare ( trees, root_state, options );
+    // A shared tree has nothing to share with.
+    if ( shared or ( table_ and not table_->enabled ( ) ) )
+        table_ = nullptr;
+    // What the trees kept from earlier searches counts against the budget as well.
+    std::unique_ptr<MemoryBudget> budget;
+    if ( options.max_memory_bytes ) {
+        std::int64_t bytes = static_cast<std::int64_t> ( options.max_memory_bytes );
+        for ( auto & tree : trees )
+            bytes -= static_cast<std::int64_t> ( tree.bytes ( ) );
+        budget.reset ( new MemoryBudget ( bytes ) );
+    }
+    // Start all jobs to grow the trees, or to grow the one shared tree.
+    std::vector<std::future<void>> futures;
     ComputeOptions job_options = options;
     job_options.verbose        = false;
+    pool.reserve ( options.number_of_threads );
     for ( int t = 0; t < options.number_of_threads; ++t ) {
-        auto func = [ t, &root_state, &job_options ] ( ) -> std::unique_ptr<Node<State>> {
-            return compute_tree ( root_state, job_options, 18'446'744'073'709'551'557ull * t + 0x0fce58188743146dull );
+        auto const seed = 18'446'744'073'709'551'557ull * ( t + seed_offset_ ) + 0x0fce58188743146dull;
+        auto & tree     = trees[ shared ? 0 : t ];
+        auto & arena    = tree.arena ( shared ? t : 0 );
+        auto func = [ this, seed, shared, &root_state, &job_options, root = tree.root ( ), &arena, dag = tree.transpositions ( ),
+                      table_, budget = budget.get ( ) ] ( ) {
+            arena.bind ( pool.this_numa_node ( ) );
+            grow_tree<State, Allocation, Policies> ( root, root_state, job_options, seed, shared, arena, dag, table_, budget );
         };
-        root_futures.push_back ( std::async ( std::launch::async, func ) );
-    }
-    // Collect the results.
-    std::vector<std::unique_ptr<Node<State>>> roots;
-    for ( int t = 0; t < options.number_of_threads; ++t )
-        roots.push_back ( std::move ( root_futures[ t ].get ( ) ) );
-    // Merge the children of all root nodes.
-    std::map<typename State::Move, int> visits;
-    std::map<typename State::Move, int> wins;
-    std::int64_t games_played = 0;
-    for ( int t = 0; t < options.number_of_threads; ++t ) {
-        auto root = roots[ t ].get ( );
-        games_played += root->visits;
-        for ( auto child = root->children.cbegin ( ); child != root->children.cend ( ); ++child ) {
-            visits[ ( *child )->move ] += ( *child )->visits;
-            wins[ ( *child )->move ] += ( *child )->wins;
+        futures.push_back ( pool.submit_to ( t, func ) );
+    }
+    for ( auto & future : futures )
+        future.get ( );
+}
+
+// The merged statistics of a root move.
+template<typename Move>
+struct MoveStatistics {
+    Move move;
+    std::int64_t visits;
+    float wins;  // In half points.
+    Proof proof; // For the player to move at the root, if the solver proved it in any tree.
+
+    // Expected success rate assuming a uniform prior (Beta(1, 1)).
+    // https://en.wikipedia.org/wiki/Beta_distribution
+    float expected_success_rate ( ) const noexcept { return ( wins + 1 ) / ( visits + 2 ); }
+};
+
+// Merges the statistics of moves without a node per move: the moves are hashed into a
+// flat table of indices (open addressing, linear probing) and the statistics are kept
+// in one vector. Integral moves hash to themselves, so for small moves the table is
+// indexed by move. The storage is kept from merge to merge.
+template<typename Move>
+class MoveMerge {
+
+    public:
+    void clear ( ) noexcept {
+        for ( std::size_t slot : slots )
+            table[ slot ] = -1;
+        slots.clear ( );
+        merged.clear ( );
+    }
+    bool empty ( ) const noexcept { return merged.empty ( ); }
+
+    // The statistics of move_, added if need be.
+    MoveStatistics<Move> & operator[] ( Move const & move_ ) {
+        if ( 2 * ( merged.size ( ) + 1 ) > table.size ( ) )
+            rehash ( std::max<std::size_t> ( 64, 2 * table.size ( ) ) );
+        std::size_t const slot = find ( move_ );
+        if ( table[ slot ] < 0 ) {
+            table[ slot ] = static_cast<std::int32_t> ( merged.size ( ) );
+            slots.push_back ( slot );
+            merged.push_back ( MoveStatistics<Move>{ move_, 0, 0.0f, Proof::none } );
         }
+        return merged[ table[ slot ] ];
     }
-    // Find the node with the highest score.
-    float best_score               = -1;
-    typename State::Move best_move = typename State::Move ( );
-    for ( auto itr : visits ) {
-        auto move = itr.first;
-        float v   = itr.second;
-        float w   = wins[ move ];
-        // Expected success rate assuming a uniform prior (Beta(1, 1)).
-        // https://en.wikipedia.org/wiki/Beta_distribution
-        float expected_success_rate = ( w + 1 ) / ( v + 2 );
-        if ( expected_success_rate > best_score ) {
-            best_move  = move;
-            best_score = expected_success_rate;
+
+    // The statistics, in the order the moves were added.
+    std::vector<MoveStatistics<Move>> & statistics ( ) noexcept { return merged; }
+    // Ends the merge, the statistics ordered by move.
+    std::vector<MoveStatistics<Move>> & sorted ( ) {
+        std::sort ( merged.begin ( ), merged.end ( ), [] ( auto const & a, auto const & b ) noexcept { return a.move < b.move; } );
+        return merged;
+    }
+
+    private:
+    static std::size_t hash ( Move const & move_ ) noexcept {
+        if constexpr ( std::is_integral<Move>::value )
+            return static_cast<std::size_t> ( move_ );
+        else
+            return std::hash<Move> ( ) ( move_ );
+    }
+    // The slot of move_, or the empty slot where it goes.
+    std::size_t find ( Move const & move_ ) const noexcept {
+        std::size_t const mask = table.size ( ) - 1;
+        std::size_t slot       = hash ( move_ ) & mask;
+        while ( table[ slot ] >= 0 and not( merged[ table[ slot ] ].move == move_ ) )
+            slot = ( slot + 1 ) & mask;
+        return slot;
+    }
+    void rehash ( std::size_t size_ ) {
+        table.assign ( size_, -1 );
+        slots.clear ( );
+        for ( std::size_t i = 0; i < merged.size ( ); ++i ) {
+            std::size_t const slot = find ( merged[ i ].move );
+            table[ slot ]          = static_cast<std::int32_t> ( i );
+            slots.push_back ( slot );
         }
-        if ( options.verbose ) {
-            std::cerr << "Move: " << itr.first << " (" << std::setw ( 2 ) << std::right
-                      << int ( 100.0 * v / float ( games_played ) + 0.5 ) << "% visits)"
-                      << " (" << std::setw ( 2 ) << std::right << int ( 100.0 * w / v + 0.5 ) << "% wins)" << std::endl;
+    }
+
+    std::vector<std::int32_t> table; // Indices into merged, -1 is empty. A power of 2 in size.
+    std::vector<std::size_t> slots;  // The slots in use.
+    std::vector<MoveStatistics<Move>> merged;
+};
+
+// Merges the children of all root nodes, ordered by move. Safe while the trees grow.
+// With grandchildren_, a move is valued against its most visited reply, see
+// ComputeOptions::merge_grandchildren.
+template<typename State, typename Allocation>
+std::vector<MoveStatistics<typename State::Move>> root_statistics ( Trees<State, Allocation> const & trees,
+                                                                    bool grandchildren_ = false ) {
+    using Move = typename State::Move;
+    static thread_local MoveMerge<Move> merge, replies;
+    merge.clear ( );
+    for ( auto & tree : trees ) {
+        auto root = tree.root ( );
+        std::lock_guard<SpinLock> guard ( root->lock );
+        for ( std::int32_t i = 0, n = static_cast<std::int32_t> ( root->children.size ( ) ); i < n; ++i ) {
+            auto & statistics = merge[ root->child_moves[ i ] ];
+            statistics.visits += root->child_visits[ i ];
+            statistics.wins += root->child_wins[ i ];
+            if ( Proof const proof = root->children[ i ]->proof; proof != Proof::none )
+                statistics.proof = proof;
+        }
+    }
+    if ( grandchildren_ ) {
+        for ( auto & statistics : merge.statistics ( ) ) {
+            replies.clear ( );
+            for ( auto & tree : trees ) {
+                auto root = tree.root ( );
+                std::lock_guard<SpinLock> guard ( root->lock );
+                auto move = std::find ( root->child_moves.begin ( ), root->child_moves.end ( ), statistics.move );
+                if ( move == root->child_moves.end ( ) )
+                    continue;
+                auto child = &*root->children[ static_cast<std::int32_t> ( move - root->child_moves.begin ( ) ) ];
+                // Lock order follows the order of play.
+                std::lock_guard<SpinLock> child_guard ( child->lock );
+                for ( std::int32_t i = 0, n = static_cast<std::int32_t> ( child->children.size ( ) ); i < n; ++i ) {
+                    auto & reply = replies[ child->child_moves[ i ] ];
+                    reply.visits += child->child_visits[ i ];
+                    reply.wins += child->child_wins[ i ];
+                }
+            }
+            if ( replies.empty ( ) )
+                continue;
+            auto const & reply = *std::max_element ( replies.statistics ( ).begin ( ), replies.statistics ( ).end ( ),
+                                                     [] ( auto const & a, auto const & b ) noexcept { return a.visits < b.visits; } );
+            // What the reply won (in half points), the move lost.
+            if ( reply.visits > 0 )
+                statistics.wins = statistics.visits * ( 2.0f - reply.wins / reply.visits );
         }
     }
+    return merge.sorted ( );
+}
+
+// Returns a proven win if there is one, otherwise the move with the highest expected
+// success rate that is not a proven loss (if possible), or no_move.
+template<typename Move>
+Move best_move ( std::vector<MoveStatistics<Move>> const & statistics, Move no_move_ ) noexcept {
+    auto rank = [] ( Proof proof_ ) noexcept { return proof_ == Proof::win ? 2 : proof_ == Proof::loss ? 0 : 1; };
+    auto best = std::max_element ( statistics.begin ( ), statistics.end ( ), [ rank ] ( auto const & a, auto const & b ) noexcept {
+        if ( rank ( a.proof ) != rank ( b.proof ) )
+            return rank ( a.proof ) < rank ( b.proof );
+        return a.expected_success_rate ( ) < b.expected_success_rate ( );
+    } );
+    return best != statistics.end ( ) ? best->move : no_move_;
+}
+
+// Merges the children of all root nodes and returns the best move. games_before_ is
+// the number of games the trees held before this search started (for the report).
+template<typename State, typename Allocation>
+typename State::Move select_move ( Trees<State, Allocation> const & trees, ComputeOptions const & options, double start_time,
+                                   std::int64_t games_before_ = 0 ) {
+    std::int64_t games_played = 0;
+    for ( auto & tree : trees )
+        games_played += tree.root ( )->visits;
+    auto const statistics = root_statistics ( trees, options.merge_grandchildren );
+    auto const best       = Mcts::best_move ( statistics, typename State::Move ( ) );
     if ( options.verbose ) {
-        auto best_wins   = wins[ best_move ];
-        auto best_visits = visits[ best_move ];
+        float best_visits = 0, best_wins = 0;
+        for ( auto & move : statistics ) {
+            float v = move.visits;
+            float w = move.wins;
+            std::cerr << "Move: " << move.move << " (" << std::setw ( 2 ) << std::right
+                      << int ( 100.0 * v / float ( games_played ) + 0.5 ) << "% visits)"
+                      << " (" << std::setw ( 2 ) << std::right << int ( 100.0 * w / v + 0.5 ) << "% wins)" << std::endl;
+            if ( move.move == best ) {
+                best_visits = v;
+                best_wins   = w;
+            }
+        }
         std::cerr << "----" << std::endl;
-        std::cerr << "Best: " << best_move << " (" << 100.0 * best_visits / float ( games_played ) << "% visits)"
+        std::cerr << "Best: " << best << " (" << 100.0 * best_visits / float ( games_played ) << "% visits)"
                   << " (" << 100.0 * best_wins / best_visits << "% wins)" << std::endl;
+        double time = wall_time ( );
+        std::cerr << games_played - games_before_ << " games played in " << float ( time - start_time ) << " s. "
+                  << "(" << float ( games_played - games_before_ ) / ( time - start_time ) << " / second, "
+                  << options.number_of_threads << " parallel jobs)." << std::endl;
     }
-    if ( options.verbose ) {
-        float time = wall_time ( );
-        std::cerr << games_played << " games played in " << float ( time - start_time ) << " s. "
-                  << "(" << float ( games_played ) / ( time - start_time ) << " / second, " << options.number_of_threads
-                  << " parallel jobs)." << std::endl;
+    return best;
+}
+
+// Returns the best move in the book of options for root_state, or no_move.
+template<typename State, typename Moves>
+typename State::Move book_move ( State const & root_state, Moves const & moves, ComputeOptions const & options ) {
+    if ( options.book ) {
+        if ( BookEntry const * entry = options.book->best ( static_cast<std::uint64_t> ( root_state.zobrist ( ) ) ) ) {
+            // Unless the hash collided with that of another position.
+            auto const move = static_cast<typename State::Move> ( entry->move );
+            if ( std::find ( moves.begin ( ), moves.end ( ), move ) != moves.end ( ) ) {
+                if ( options.verbose )
+                    std::cerr << "Book: " << move << " (" << entry->visits << " visits)." << std::endl;
+                return move;
+            }
+        }
+    }
+    return State::no_move;
+}
+
+template<typename State, typename Allocation, typename Policies>
+typename State::Move Engine::compute_move ( State const & root_state, ComputeOptions const & options ) {
+    auto moves = root_state.get_moves ( );
+    attest ( moves.size ( ) > 0 );
+    if ( moves.size ( ) == 1 )
+        return moves[ 0 ];
+    if ( auto const move = book_move ( root_state, moves, options ); move != State::no_move )
+        return move;
+    double start_time = wall_time ( );
+    Trees<State, Allocation> trees;
+    TranspositionTable<typename State::ZobristHash> table ( options.transposition_table_bytes );
+    grow<State, Allocation, Policies> ( trees, root_state, options, 0, &table );
+    return select_move ( trees, options, start_time );
+}
+
+// A search that keeps its trees between calls. After a move has been played
+// (by either side), the trees are re-rooted at the matching child and only the
+// discarded siblings are freed, so every turn starts with the statistics that
+// were gathered for that position during the previous searches.
+template<typename State, typename Allocation = HeapAllocation, typename Policies = DefaultPolicies>
+class Search {
+
+    public:
+    using Move        = typename State::Move;
+    using ZobristHash = typename State::ZobristHash;
+
+    explicit Search ( Engine & engine_ = default_engine ( ) ) : engine ( &engine_ ) {}
+    Search ( Search const & ) = delete;
+    Search & operator= ( Search const & ) = delete;
+    ~Search ( ) { stop ( ); }
+
+    // Re-roots at root_state if it is (a child or a grandchild of) the current root,
+    // otherwise the trees are discarded. Then searches and returns the best move.
+    Move compute_move ( State const & root_state, ComputeOptions const & options = ComputeOptions ( ) );
+
+    // Searches root_state in the background, on the opponent's time, and returns
+    // immediately. The search runs until stop ( ), or until the budget in options
+    // runs out. The next call (other than pondering ( )) stops it, so the trees
+    // grown from root_state are picked up by the next compute_move.
+    void ponder ( State const & root_state, ComputeOptions const & options = ComputeOptions ( ) );
+    // Stops pondering (if we are) and waits for the threads to finish.
+    void stop ( );
+    // Asks pondering to stop and returns immediately, safe from any thread.
+    void request_stop ( ) noexcept { stop_pondering.store ( true, std::memory_order_relaxed ); }
+    // Waits for pondering to use up its budget.
+    void wait ( );
+    bool pondering ( ) const noexcept { return ponder_thread.joinable ( ); }
+    // True if there is no background search or it has used up its budget.
+    bool finished ( ) const noexcept { return not pondering ( ) or ponder_done.load ( std::memory_order_acquire ); }
+
+    // The statistics of the root moves and the best move (no_move if there are no
+    // statistics). Safe while pondering.
+    std::vector<MoveStatistics<Move>> statistics ( ) const { return root_statistics ( trees_ ); }
+    Move best_move ( ) const { return Mcts::best_move ( statistics ( ), State::no_move ); }
+
+    // Re-roots all trees at the child reached by move_. Trees that never tried
+    // move_ are discarded.
+    void do_move ( Move const & move_ );
+
+    // Finds root_state in the top two levels of the trees and re-roots there.
+    // Returns false (and discards the trees) if it is not found.
+    bool reroot ( State const & root_state );
+
+    void clear ( ) {
+        stop ( );
+        trees_.clear ( );
+        table.clear ( );
+    }
+
+    // The number of games the kept trees hold for the current root.
+    std::int64_t games ( ) const noexcept {
+        std::int64_t n = 0;
+        for ( auto & tree : trees_ )
+            n += tree.root ( )->visits;
+        return n;
+    }
+
+    // Not while pondering.
+    Trees<State, Allocation> const & trees ( ) const noexcept { return trees_; }
+
+    private:
+    Engine * engine;
+    Trees<State, Allocation> trees_;
+    // Kept between moves as well, the statistics of a position don't depend on the root.
+    TranspositionTable<ZobristHash> table;
+    sax::Rng::result_type generation = 0;
+    std::thread ponder_thread;
+    std::atomic<bool> stop_pondering{ false }, ponder_done{ false };
+};
+
+template<typename State, typename Allocation, typename Policies>
+void Search<State, Allocation, Policies>::do_move ( Move const & move_ ) {
+    stop ( );
+    Trees<State, Allocation> kept;
+    for ( auto & tree : trees_ ) {
+        auto root = tree.root ( );
+        auto move = std::find ( root->child_moves.begin ( ), root->child_moves.end ( ), move_ );
+        if ( move != root->child_moves.end ( ) ) {
+            tree.reroot ( &*root->children[ static_cast<std::int32_t> ( move - root->child_moves.begin ( ) ) ] );
+            kept.push_back ( std::move ( tree ) );
+        }
+    }
+    trees_ = std::move ( kept );
+}
+
+template<typename State, typename Allocation, typename Policies>
+bool Search<State, Allocation, Policies>::reroot ( State const & root_state ) {
+    stop ( );
+    ZobristHash const hash = root_state.zobrist ( );
+    Trees<State, Allocation> kept;
+    for ( auto & tree : trees_ ) {
+        if ( auto node = tree.find ( hash ) ) {
+            tree.reroot ( node );
+            kept.push_back ( std::move ( tree ) );
+        }
+    }
+    trees_ = std::move ( kept );
+    return not trees_.empty ( );
+}
+
+template<typename State, typename Allocation, typename Policies>
+typename State::Move Search<State, Allocation, Policies>::compute_move ( State const & root_state, ComputeOptions const & options ) {
+    auto moves = root_state.get_moves ( );
+    attest ( moves.size ( ) > 0 );
+    if ( moves.size ( ) == 1 )
+        return moves[ 0 ];
+    if ( auto const move = book_move ( root_state, moves, options ); move != State::no_move ) {
+        stop ( );
+        return move;
     }
-    return best_move;
+    double start_time = wall_time ( );
+    reroot ( root_state ); // Stops pondering.
+    std::int64_t const games_before = games ( );
+    if ( options.verbose and games_before )
+        std::cerr << "Reusing " << games_before << " games." << std::endl;
+    table.resize ( options.transposition_table_bytes );
+    // Re-rooting took some of the time.
+    ComputeOptions grow_options = options;
+    if ( options.max_time >= 0 )
+        grow_options.max_time = std::max ( 0.0f, options.max_time - float ( wall_time ( ) - start_time ) );
+    engine->template grow<State, Allocation, Policies> ( trees_, root_state, grow_options, generation += options.number_of_threads, &table );
+    return select_move ( trees_, options, start_time, games_before );
+}
+
+template<typename State, typename Allocation, typename Policies>
+void Search<State, Allocation, Policies>::ponder ( State const & root_state, ComputeOptions const & options ) {
+    reroot ( root_state ); // Stops pondering.
+    if ( root_state.get_moves ( ).size ( ) == 0 )
+        return;
+    table.resize ( options.transposition_table_bytes );
+    ComputeOptions ponder_options = options;
+    ponder_options.verbose        = false;
+    ponder_options.stop           = &stop_pondering;
+    stop_pondering.store ( false, std::memory_order_relaxed );
+    ponder_done.store ( false, std::memory_order_relaxed );
+    // The trees are read while they grow, they can't be created on the fly.
+    Engine::prepare ( trees_, root_state, ponder_options );
+    // A thread of its own, a pool worker waiting for the jobs would take a worker away.
+    ponder_thread = std::thread ( [ this, root_state, ponder_options, seed_offset = generation += options.number_of_threads ] ( ) {
+        engine->template grow<State, Allocation, Policies> ( trees_, root_state, ponder_options, seed_offset, &table );
+        ponder_done.store ( true, std::memory_order_release );
+    } );
+}
+
+template<typename State, typename Allocation, typename Policies>
+void Search<State, Allocation, Policies>::stop ( ) {
+    if ( ponder_thread.joinable ( ) ) {
+        stop_pondering.store ( true, std::memory_order_relaxed );
+        ponder_thread.join ( );
+    }
+}
+
+template<typename State, typename Allocation, typename Policies>
+void Search<State, Allocation, Policies>::wait ( ) {
+    if ( ponder_thread.joinable ( ) )
+        ponder_thread.join ( );
+}
+
+// A search running in the background. The current best move and the root
+// statistics can be read at any time, the search can be stopped early or be
+// given a new budget.
+template<typename State, typename Allocation = HeapAllocation, typename Policies = DefaultPolicies>
+class SearchHandle {
+
+    public:
+    using Move = typename State::Move;
+
+    // Starts searching root_state, returns immediately.
+    SearchHandle ( State const & root_state_, ComputeOptions const & options, Engine & engine_ = default_engine ( ) ) :
+        search ( engine_ ), root_state ( root_state_ ) {
+        search.ponder ( root_state, options );
+    }
+
+    // The best move so far, no_move if there are no statistics yet.
+    Move best_move ( ) const { return search.best_move ( ); }
+    std::vector<MoveStatistics<Move>> statistics ( ) const { return search.statistics ( ); }
+    std::int64_t games ( ) const noexcept { return search.games ( ); }
+
+    // Continues with a new budget, counted from now. The statistics are kept.
+    void extend ( ComputeOptions const & options ) { search.ponder ( root_state, options ); }
+    // Stops the search early, returns immediately and is safe from any thread (wait ( )
+    // for the threads to finish). The statistics stay readable.
+    void stop ( ) noexcept { search.request_stop ( ); }
+    // Waits for the search to use up its budget and returns the best move.
+    Move wait ( ) {
+        search.wait ( );
+        return best_move ( );
+    }
+    bool done ( ) const noexcept { return search.finished ( ); }
+
+    private:
+    Search<State, Allocation, Policies> search;
+    State root_state;
+};
+
+template<typename State, typename Allocation = HeapAllocation, typename Policies = DefaultPolicies>
+SearchHandle<State, Allocation, Policies> start_search ( State const & root_state, ComputeOptions const & options = ComputeOptions ( ),
+                                                         Engine & engine_ = default_engine ( ) ) {
+    return SearchHandle<State, Allocation, Policies> ( root_state, options, engine_ );
 }
 
 inline void check ( bool expr, char const * message ) {
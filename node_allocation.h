@@ -0,0 +1,317 @@
+//
+// MIT License.
+//
+// degski 2020
+// degski@gmail.com
+//
+// Allocation policies for the nodes of a search tree.
+//
+// HeapAllocation:  every node is a separate heap allocation, owned by its
+//                  parent through a std::unique_ptr. Freeing a tree is a
+//                  recursive cascade of destructors.
+//
+// ArenaAllocation: the nodes, their child lists and their untried move lists
+//                  are carved out of an Arena (a bump allocator over large
+//                  blocks). Every thread growing a tree has its own arena, so
+//                  there is no allocator contention. The nodes are trivially
+//                  destructible and a tree is freed by dropping its blocks.
+//                  An arena can be bound to a NUMA node, its blocks then
+//                  prefer the memory of that node (Linux only).
+//
+// A policy provides the Arena type, the Array (children and child statistics)
+// and MoveList containers of a node, make_moves, make_array, reserve and make
+// (which constructs a node), and frees_nodes, which tells whether detaching a
+// subtree frees it.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined( __linux__ )
+#    include <sys/mman.h>
+#    include <sys/syscall.h>
+#    include <unistd.h>
+#endif
+
+#include "../compact_vector/include/compact_vector.hpp"
+
+namespace Mcts {
+
+// A bump allocator. Memory is only given back when the arena is destroyed
+// or cleared, no destructors are run.
+class Arena {
+
+    public:
+    static constexpr std::size_t block_size = 1 << 20;
+
+    Arena ( ) noexcept = default;
+    Arena ( Arena const & ) = delete;
+    Arena ( Arena && other_ ) noexcept :
+        blocks ( std::move ( other_.blocks ) ), top ( std::exchange ( other_.top, nullptr ) ),
+        end ( std::exchange ( other_.end, nullptr ) ), reserved ( std::exchange ( other_.reserved, 0 ) ),
+        node ( std::exchange ( other_.node, -1 ) ) {}
+    ~Arena ( ) noexcept = default;
+
+    Arena & operator= ( Arena const & ) = delete;
+    Arena & operator= ( Arena && other_ ) noexcept {
+        blocks   = std::move ( other_.blocks );
+        top      = std::exchange ( other_.top, nullptr );
+        end      = std::exchange ( other_.end, nullptr );
+        reserved = std::exchange ( other_.reserved, 0 );
+        node     = std::exchange ( other_.node, -1 );
+        return *this;
+    }
+
+    [[nodiscard]] void * allocate ( std::size_t size_, std::size_t align_ ) {
+        std::size_t offset = padding ( align_ );
+        if ( not top or size_ + offset > static_cast<std::size_t> ( end - top ) ) {
+            add_block ( std::max ( block_size, size_ + align_ ) );
+            offset = padding ( align_ );
+        }
+        void * ptr = top + offset;
+        top += offset + size_;
+        return ptr;
+    }
+
+    // Uninitialized storage for n_ objects of type T.
+    template<typename T>
+    [[nodiscard]] T * allocate ( std::size_t n_ = 1 ) {
+        return static_cast<T *> ( allocate ( n_ * sizeof ( T ), alignof ( T ) ) );
+    }
+
+    void clear ( ) noexcept {
+        blocks.clear ( );
+        top = end = nullptr;
+        reserved  = 0;
+    }
+
+    // The blocks added from now on prefer the memory of NUMA node node_, -1 is
+    // wherever they are first touched.
+    void bind ( int node_ ) noexcept { node = node_; }
+
+    // The number of bytes held in blocks.
+    std::size_t bytes ( ) const noexcept { return reserved; }
+    // The number of bytes handed out (about, the unused ends of full blocks count).
+    std::size_t used ( ) const noexcept { return reserved - static_cast<std::size_t> ( end - top ); }
+
+    private:
+    std::size_t padding ( std::size_t align_ ) const noexcept {
+        return ( align_ - reinterpret_cast<std::uintptr_t> ( top ) % align_ ) % align_;
+    }
+
+    // Gives a block back the way add_block got it.
+    struct Unmap {
+        std::size_t size = 0;
+        void operator( ) ( char * block_ ) const noexcept {
+#if defined( __linux__ )
+            ::munmap ( block_, size );
+#else
+            delete[] block_;
+#endif
+        }
+    };
+    using Block = std::unique_ptr<char[], Unmap>;
+
+    void add_block ( std::size_t size_ ) {
+        Block block ( map ( size_ ), Unmap { size_ } );
+        blocks.push_back ( std::move ( block ) );
+        top = blocks.back ( ).get ( );
+        end = top + size_;
+        reserved += size_;
+    }
+
+    // On Linux a block is fresh pages of its own, so that it can be bound to
+    // node before anything touches (and so places) them. Heap memory may have
+    // been touched already.
+    char * map ( std::size_t size_ ) const {
+#if defined( __linux__ )
+        void * const block = ::mmap ( nullptr, size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0 );
+        if ( block == MAP_FAILED )
+            throw std::bad_alloc ( );
+        if ( node >= 0 )
+            place ( block, size_ );
+        return static_cast<char *> ( block );
+#else
+        return new char[ size_ ];
+#endif
+    }
+
+#if defined( __linux__ )
+    // Asks for the pages of the (page aligned) block to come from node.
+    void place ( void * block_, std::size_t size_ ) const noexcept {
+#    if defined( SYS_mbind )
+        constexpr int preferred = 1; // MPOL_PREFERRED
+        constexpr int bits      = 8 * sizeof ( unsigned long );
+        if ( node >= bits )
+            return;
+        unsigned long const mask = 1ul << node;
+        syscall ( SYS_mbind, block_, size_, preferred, &mask, bits + 1, 0 );
+#    else
+        ( void ) block_;
+        ( void ) size_;
+#    endif
+    }
+#endif
+
+    std::vector<Block> blocks;
+    char * top           = nullptr;
+    char * end           = nullptr;
+    std::size_t reserved = 0;
+    int node             = -1;
+};
+
+// A fixed capacity vector, its storage lives in an Arena. Mimics the parts of
+// sax::compact_vector that Node uses.
+template<typename T>
+class ArenaVector {
+
+    static_assert ( std::is_trivially_destructible<T>::value, "T is not trivially destructible" );
+
+    public:
+    using value_type     = T;
+    using size_type      = std::int32_t;
+    using iterator       = T *;
+    using const_iterator = T const *;
+
+    ArenaVector ( ) noexcept = default;
+    ArenaVector ( size_type capacity_, Arena & arena_ ) :
+        first ( capacity_ ? arena_.allocate<T> ( capacity_ ) : nullptr ), count ( 0 ), max_count ( capacity_ ) {}
+    // A copy of other_, with the same capacity, in arena_.
+    ArenaVector ( ArenaVector const & other_, Arena & arena_ ) : ArenaVector ( other_.max_count, arena_ ) {
+        std::uninitialized_copy ( other_.begin ( ), other_.end ( ), first );
+        count = other_.count;
+    }
+    // A copy of range_, with capacity range_.size ( ), in arena_.
+    template<typename Range>
+    ArenaVector ( Range const & range_, Arena & arena_ ) : ArenaVector ( static_cast<size_type> ( range_.size ( ) ), arena_ ) {
+        std::uninitialized_copy ( range_.begin ( ), range_.end ( ), first );
+        count = max_count;
+    }
+
+    size_type size ( ) const noexcept { return count; }
+    size_type capacity ( ) const noexcept { return max_count; }
+    bool empty ( ) const noexcept { return not count; }
+    // Released vectors have no storage (anymore).
+    bool is_released ( ) const noexcept { return not first; }
+    void reset ( ) noexcept {
+        first = nullptr;
+        count = max_count = 0;
+    }
+
+    template<typename... Args>
+    T & emplace_back ( Args &&... args_ ) noexcept {
+        return *new ( first + count++ ) T ( std::forward<Args> ( args_ )... );
+    }
+    void pop_back ( ) noexcept { --count; }
+    // Removes the element at i_, the last element takes its place.
+    T unordered_erase ( size_type i_ ) noexcept {
+        T value     = first[ i_ ];
+        first[ i_ ] = first[ --count ];
+        return value;
+    }
+
+    T & operator[] ( size_type i_ ) noexcept { return first[ i_ ]; }
+    T const & operator[] ( size_type i_ ) const noexcept { return first[ i_ ]; }
+    T & front ( ) noexcept { return first[ 0 ]; }
+    T const & front ( ) const noexcept { return first[ 0 ]; }
+    T & back ( ) noexcept { return first[ count - 1 ]; }
+    T const & back ( ) const noexcept { return first[ count - 1 ]; }
+    T * data ( ) noexcept { return first; }
+    T const * data ( ) const noexcept { return first; }
+
+    iterator begin ( ) noexcept { return first; }
+    iterator end ( ) noexcept { return first + count; }
+    const_iterator begin ( ) const noexcept { return first; }
+    const_iterator end ( ) const noexcept { return first + count; }
+    const_iterator cbegin ( ) const noexcept { return first; }
+    const_iterator cend ( ) const noexcept { return first + count; }
+
+    private:
+    T * first           = nullptr;
+    size_type count     = 0;
+    size_type max_count = 0;
+};
+
+struct HeapAllocation {
+
+    // Nothing to hold on to, the nodes come from the global heap.
+    // Nodes come from the allocator of the thread that grows the tree, which touches
+    // them first, so they are placed on its NUMA node by the OS.
+    struct Arena {
+        void bind ( int ) noexcept {}
+        std::size_t bytes ( ) const noexcept { return 0; }
+    };
+
+    template<typename T>
+    using Array = sax::compact_vector<T>;
+    template<typename Node>
+    using Children = Array<std::unique_ptr<Node>>;
+    template<typename Moves>
+    using MoveList = Moves;
+
+    static constexpr bool frees_nodes = true;
+
+    template<typename Moves>
+    static Moves make_moves ( Moves && moves_, Arena & ) noexcept {
+        return std::move ( moves_ );
+    }
+    // Leaves never allocate, the storage is reserved on the first expansion.
+    template<typename Array>
+    static Array make_array ( std::size_t, Arena & ) {
+        return Array ( );
+    }
+    // Expansion never reallocates after this, other threads may be updating the elements.
+    template<typename Array>
+    static void reserve ( Array & array_, std::size_t capacity_, Arena & ) {
+        array_.reserve ( static_cast<typename Array::size_type> ( capacity_ ) );
+    }
+    template<typename Node, typename... Args>
+    static Node * make ( Arena &, Args &&... args_ ) {
+        return new Node ( std::forward<Args> ( args_ )... );
+    }
+};
+
+struct ArenaAllocation {
+
+    using Arena = Mcts::Arena;
+
+    template<typename T>
+    using Array = ArenaVector<T>;
+    template<typename Node>
+    using Children = Array<Node *>;
+    template<typename Moves>
+    using MoveList = Array<typename Moves::value_type>;
+
+    static constexpr bool frees_nodes = false;
+
+    template<typename Moves>
+    static MoveList<Moves> make_moves ( Moves && moves_, Arena & arena_ ) {
+        return MoveList<Moves> ( moves_, arena_ );
+    }
+    template<typename Array>
+    static Array make_array ( std::size_t capacity_, Arena & arena_ ) {
+        return Array ( static_cast<typename Array::size_type> ( capacity_ ), arena_ );
+    }
+    // As with the heap, leaves have no storage, it is taken on the first expansion
+    // (the array is empty then).
+    template<typename Array>
+    static void reserve ( Array & array_, std::size_t capacity_, Arena & arena_ ) {
+        if ( static_cast<std::size_t> ( array_.capacity ( ) ) < capacity_ )
+            array_ = Array ( static_cast<typename Array::size_type> ( capacity_ ), arena_ );
+    }
+    template<typename Node, typename... Args>
+    static Node * make ( Arena & arena_, Args &&... args_ ) {
+        static_assert ( std::is_trivially_destructible<Node>::value, "arena allocated nodes are never destroyed" );
+        return new ( arena_.allocate<Node> ( ) ) Node ( std::forward<Args> ( args_ )... );
+    }
+};
+
+} // namespace Mcts
@@ -0,0 +1,121 @@
+//
+// MIT License.
+//
+// degski 2020
+// degski@gmail.com
+//
+// An opening book: the statistics of the moves of positions that were searched
+// in advance, keyed by the Zobrist hash of the position.
+//
+// A book file is a BookFileHeader followed by BookEntry's sorted by hash (and
+// by move), in native byte order. An OpeningBook maps the file read-only and
+// a lookup is a binary search over the mapped entries, nothing is loaded or
+// parsed. compute_move consults ComputeOptions::book before it searches. See
+// book_builder.h for building books.
+//
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "mapped_file.h"
+
+namespace Mcts {
+
+struct BookEntry {
+    std::uint64_t hash;
+    std::int32_t move;
+    std::int32_t visits;
+    float wins; // In half points.
+    std::uint32_t unused;
+
+    // As MoveStatistics::expected_success_rate.
+    float expected_success_rate ( ) const noexcept { return ( wins + 1 ) / ( visits + 2 ); }
+
+    bool operator< ( BookEntry const & other_ ) const noexcept {
+        return hash < other_.hash or ( hash == other_.hash and move < other_.move );
+    }
+};
+
+struct BookFileHeader {
+    static constexpr char magic_bytes[ 8 ]     = { 'M', 'C', 'T', 'S', 'B', 'O', 'O', 'K' };
+    static constexpr std::uint32_t current_version = 1;
+
+    char magic[ 8 ];
+    std::uint32_t version;
+    std::uint32_t entry_size; // sizeof ( BookEntry ), guards against a different layout.
+    std::uint64_t number_of_entries;
+
+    bool is_valid ( ) const noexcept {
+        return std::memcmp ( magic, magic_bytes, sizeof ( magic ) ) == 0 and version == current_version and
+               entry_size == sizeof ( BookEntry );
+    }
+};
+
+static_assert ( sizeof ( BookEntry ) == 24 and sizeof ( BookFileHeader ) == 24, "the book entries are 8 byte aligned" );
+
+class OpeningBook {
+
+    public:
+    // An empty book.
+    OpeningBook ( ) noexcept = default;
+    // Maps the book at path_. Throws std::runtime_error if the file can't be mapped
+    // or is not a book of this version.
+    explicit OpeningBook ( std::string const & path_ );
+
+    std::size_t size ( ) const noexcept { return file.empty ( ) ? 0 : static_cast<std::size_t> ( header ( ).number_of_entries ); }
+    bool empty ( ) const noexcept { return not size ( ); }
+    BookEntry const * begin ( ) const noexcept {
+        return file.empty ( ) ? nullptr : reinterpret_cast<BookEntry const *> ( file.data ( ) + sizeof ( BookFileHeader ) );
+    }
+    BookEntry const * end ( ) const noexcept { return begin ( ) + size ( ); }
+
+    // The entries of the position hash_, an empty range if it is not in the book.
+    std::pair<BookEntry const *, BookEntry const *> find ( std::uint64_t hash_ ) const noexcept {
+        auto first = std::lower_bound ( begin ( ), end ( ), hash_, [] ( BookEntry const & e, std::uint64_t h ) { return e.hash < h; } );
+        auto last  = std::find_if ( first, end ( ), [ hash_ ] ( BookEntry const & e ) { return e.hash != hash_; } );
+        return { first, last };
+    }
+    // The entry with the highest expected success rate of the position hash_, or
+    // nullptr.
+    BookEntry const * best ( std::uint64_t hash_ ) const noexcept {
+        auto [ first, last ] = find ( hash_ );
+        auto best            = std::max_element ( first, last, [] ( BookEntry const & a, BookEntry const & b ) {
+            return a.expected_success_rate ( ) < b.expected_success_rate ( );
+        } );
+        return best != last ? best : nullptr;
+    }
+
+    private:
+    BookFileHeader const & header ( ) const noexcept { return *reinterpret_cast<BookFileHeader const *> ( file.data ( ) ); }
+
+    MappedFile file;
+};
+
+inline OpeningBook::OpeningBook ( std::string const & path_ ) : file ( path_ ) {
+    if ( file.size ( ) < sizeof ( BookFileHeader ) or not header ( ).is_valid ( ) or
+         ( file.size ( ) - sizeof ( BookFileHeader ) ) / sizeof ( BookEntry ) < header ( ).number_of_entries or
+         not std::is_sorted ( begin ( ), end ( ) ) )
+        throw std::runtime_error ( "not an opening book (of this version) " + path_ );
+}
+
+// Sorts entries_ and writes them to path_, throws std::runtime_error on failure.
+inline void write_opening_book ( std::string const & path_, std::vector<BookEntry> entries_ ) {
+    std::sort ( entries_.begin ( ), entries_.end ( ) );
+    BookFileHeader header{ { }, BookFileHeader::current_version, sizeof ( BookEntry ), entries_.size ( ) };
+    std::memcpy ( header.magic, BookFileHeader::magic_bytes, sizeof ( header.magic ) );
+    std::unique_ptr<std::FILE, int ( * ) ( std::FILE * )> file ( std::fopen ( path_.c_str ( ), "wb" ), &std::fclose );
+    if ( not file or std::fwrite ( &header, sizeof ( header ), 1, file.get ( ) ) != 1 or
+         std::fwrite ( entries_.data ( ), sizeof ( BookEntry ), entries_.size ( ), file.get ( ) ) != entries_.size ( ) or
+         std::fflush ( file.get ( ) ) )
+        throw std::runtime_error ( "cannot write opening book " + path_ );
+}
+
+} // namespace Mcts
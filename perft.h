@@ -0,0 +1,116 @@
+//
+// MIT License.
+//
+// degski 2020
+// degski@gmail.com
+//
+// Perft: plays every sequence of moves up to a depth and counts the positions, to
+// measure (and to check) the move generation of a State. Only get_moves and
+// do_move are used. The counts of a State are fixed, so a change to its move
+// generation that changes them is a bug.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <future>
+#include <vector>
+
+#include "mcts.h"
+#include "thread_pool.h"
+
+namespace Mcts {
+
+struct PerftCounts {
+
+    std::uint64_t nodes     = 0; // The positions reached, the root not counted.
+    std::uint64_t leaves    = 0; // The positions at the full depth.
+    std::uint64_t terminals = 0; // The games that are over before the full depth.
+    double seconds          = 0.0;
+
+    double nodes_per_second ( ) const noexcept { return seconds > 0.0 ? static_cast<double> ( nodes ) / seconds : 0.0; }
+
+    PerftCounts & operator+= ( PerftCounts const & other_ ) noexcept {
+        nodes += other_.nodes;
+        leaves += other_.leaves;
+        terminals += other_.terminals;
+        return *this;
+    }
+    // The counts, not the time.
+    bool operator== ( PerftCounts const & other_ ) const noexcept {
+        return nodes == other_.nodes and leaves == other_.leaves and terminals == other_.terminals;
+    }
+    bool operator!= ( PerftCounts const & other_ ) const noexcept { return not( *this == other_ ); }
+};
+
+// Counts the positions below state_, depth_ > 0.
+template<typename State>
+void perft_count ( State const & state_, int depth_, PerftCounts & counts_ ) {
+    auto const moves = state_.get_moves ( );
+    if ( moves.empty ( ) ) {
+        counts_.terminals += 1;
+        return;
+    }
+    for ( auto const & move : moves ) {
+        State state = state_;
+        state.do_move ( move );
+        counts_.nodes += 1;
+        if ( depth_ == 1 )
+            counts_.leaves += 1;
+        else
+            perft_count ( state, depth_ - 1, counts_ );
+    }
+}
+
+// The positions up to depth_ moves from root_state. With more than one thread, the
+// tree is split at the root (and further down, until there are a few parts per
+// thread), the threads take the parts in turn.
+template<typename State>
+PerftCounts perft ( State const & root_state, int depth_, int number_of_threads_ = 1 ) {
+    check ( depth_ >= 0, "perft needs a depth of 0 or more" );
+    double const start_time = wall_time ( );
+    PerftCounts counts;
+    std::vector<State> parts ( 1, root_state ), next;
+    int depth = depth_;
+    while ( depth > 1 and number_of_threads_ > 1 and parts.size ( ) < 4 * static_cast<std::size_t> ( number_of_threads_ ) ) {
+        next.clear ( );
+        for ( auto const & part : parts ) {
+            auto const moves = part.get_moves ( );
+            if ( moves.empty ( ) )
+                counts.terminals += 1;
+            for ( auto const & move : moves ) {
+                next.push_back ( part );
+                next.back ( ).do_move ( move );
+            }
+        }
+        counts.nodes += next.size ( );
+        parts.swap ( next );
+        --depth;
+    }
+    if ( depth == 0 ) {
+        counts.leaves += parts.size ( );
+    }
+    else if ( number_of_threads_ <= 1 ) {
+        for ( auto const & part : parts )
+            perft_count ( part, depth, counts );
+    }
+    else {
+        ThreadPool pool ( number_of_threads_, Placement::none );
+        std::atomic<std::size_t> taken ( 0 );
+        std::vector<std::future<PerftCounts>> futures;
+        for ( int t = 0; t < number_of_threads_; ++t )
+            futures.push_back ( pool.submit ( [ & ] ( ) {
+                PerftCounts thread_counts;
+                for ( std::size_t p = taken++; p < parts.size ( ); p = taken++ )
+                    perft_count ( parts[ p ], depth, thread_counts );
+                return thread_counts;
+            } ) );
+        for ( auto & future : futures )
+            counts += future.get ( );
+    }
+    counts.seconds = wall_time ( ) - start_time;
+    return counts;
+}
+
+} // namespace Mcts
@@ -0,0 +1,113 @@
+//
+// MIT License.
+//
+// degski 2020
+// degski@gmail.com
+//
+// Where the time of a search goes.
+//
+// With ComputeOptions::profile set, every search thread times the phases of
+// its iterations and counts what it did, and adds that to the profile when it
+// is done. Reading the clock four times per iteration costs a good part of a
+// cheap playout, a search without a profile doesn't. Define MCTS_PROFILE to 0
+// to compile the profiling out altogether.
+//
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+
+#ifndef MCTS_PROFILE
+#    define MCTS_PROFILE 1
+#endif
+
+namespace Mcts {
+
+struct SearchProfile {
+
+    enum Phase : int { selection, expansion, evaluation, simulation, backpropagation, phases };
+
+    double seconds[ phases ] = { }; // Per phase, summed over the threads.
+    std::int64_t iterations      = 0;
+    std::int64_t selection_depth = 0; // The children descended into, summed over the iterations.
+    std::int64_t playout_moves   = 0; // Summed over the iterations, if State::simulate counts them.
+    std::int64_t nodes           = 0; // Allocated, transpositions that are linked to are not counted.
+    std::int64_t bytes           = 0; // Taken by the nodes added, see Node::bytes.
+
+    double average_depth ( ) const noexcept { return iterations ? double ( selection_depth ) / iterations : 0.0; }
+    double average_playout_length ( ) const noexcept { return iterations ? double ( playout_moves ) / iterations : 0.0; }
+    double total_seconds ( ) const noexcept {
+        double total = 0.0;
+        for ( double s : seconds )
+            total += s;
+        return total;
+    }
+
+    SearchProfile & operator+= ( SearchProfile const & other_ ) noexcept {
+        for ( int p = 0; p < phases; ++p )
+            seconds[ p ] += other_.seconds[ p ];
+        iterations += other_.iterations;
+        selection_depth += other_.selection_depth;
+        playout_moves += other_.playout_moves;
+        nodes += other_.nodes;
+        bytes += other_.bytes;
+        return *this;
+    }
+
+    // Adds other_ to this profile, which other threads may add to as well.
+    void add ( SearchProfile const & other_ ) {
+        static std::mutex mutex;
+        std::lock_guard<std::mutex> lock ( mutex );
+        *this += other_;
+    }
+};
+
+// Times the phases of the iterations of one thread: lap ( phase ) ends the phase
+// that started at the previous lap (or at start). Does nothing without a profile
+// and compiles to nothing without MCTS_PROFILE.
+class PhaseClock {
+
+    using Clock = std::chrono::steady_clock;
+
+    public:
+#if MCTS_PROFILE
+    explicit PhaseClock ( SearchProfile * profile_ ) noexcept : profile ( profile_ ) {}
+
+    bool on ( ) const noexcept { return profile; }
+    void start ( ) noexcept {
+        if ( profile )
+            last = Clock::now ( );
+    }
+    void lap ( SearchProfile::Phase phase_ ) noexcept {
+        if ( profile ) {
+            Clock::time_point const now = Clock::now ( );
+            ticks[ phase_ ] += ( now - last ).count ( );
+            last = now;
+        }
+    }
+    // Moves the times to the profile.
+    void stop ( ) noexcept {
+        if ( profile )
+            for ( int p = 0; p < SearchProfile::phases; ++p ) {
+                profile->seconds[ p ] += double ( ticks[ p ] ) * Clock::period::num / Clock::period::den;
+                ticks[ p ] = 0;
+            }
+    }
+
+    private:
+    SearchProfile * profile;
+    Clock::time_point last;
+    Clock::rep ticks[ SearchProfile::phases ] = { };
+#else
+    explicit PhaseClock ( SearchProfile * ) noexcept {}
+
+    static constexpr bool on ( ) noexcept { return false; }
+    void start ( ) noexcept {}
+    void lap ( SearchProfile::Phase ) noexcept {}
+    void stop ( ) noexcept {}
+#endif
+};
+
+} // namespace Mcts
@@ -4,11 +4,22 @@
 #include <catch.hpp>
 
 #include <mcts.h>
+#include <perft.h>
 
 #include "games/go.h"
 
 using namespace std;
 
+TEST_CASE("go_perft")
+{
+	// No captures and no passes in the first three moves.
+	auto counts = Mcts::perft(GoState<3, 3>(), 3);
+	CHECK(counts.nodes == 9 + 72 + 504);
+	CHECK(counts.leaves == 504);
+	CHECK(counts.terminals == 0);
+	CHECK(Mcts::perft(GoState<3, 3>(), 3, 4) == counts);
+}
+
 TEST_CASE("go_game_over1")
 {
 	static const int M = 3;
@@ -109,16 +120,17 @@ TEST_CASE("go3")
 
 	state.do_move(GoState<M, N>::ij_to_ind(2, 0));
 
-	MCTS::ComputeOptions options;
+	Mcts::ComputeOptions options;
 	options.max_iterations = 100;
 	options.max_time = 1.0;
 	options.verbose = false;
-	auto tree = MCTS::compute_tree(state, options, 1);
-	REQUIRE(tree->has_children());
-	REQUIRE(tree->children.size() == 2);
+	auto tree = Mcts::compute_tree(state, options, 1);
+	auto root = tree.root();
+	REQUIRE(root->has_children());
+	REQUIRE(root->children.size() == 2);
 	std::set<GoState<M, N>::Move> move_set;
-	move_set.insert(tree->children[0]->move);
-	move_set.insert(tree->children[1]->move);
+	move_set.insert(root->children[0]->move);
+	move_set.insert(root->children[1]->move);
 	REQUIRE(move_set.find(GoState<M, N>::ij_to_ind(0, 0)) != move_set.end());
 	REQUIRE(move_set.find(GoState<M, N>::ij_to_ind(1, 0)) != move_set.end());
 }
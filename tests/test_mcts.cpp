@@ -3,8 +3,19 @@
 #define CATCH_CONFIG_MAIN
 #include <catch.hpp>
 
+#include <book_builder.h>
 #include <mcts.h>
+#include <compact_tree.h>
+#include <distributed.h>
+#include <perft.h>
+#include <tree_file.h>
 
+#ifndef _WIN32
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+#include "games/connect_four.h"
 #include "games/nim.h"
 
 using namespace std;
@@ -23,7 +34,10 @@ class TestGame
 {
 public:
 	typedef int Move;
-	static const Move no_move = -1;
+	typedef sax::compact_vector<Move> Moves;
+	typedef std::uint64_t ZobristHash;
+	typedef int value_type;
+	static constexpr Move no_move = -1;
 
 	TestGame(int X_ = 2)
 		: player_to_move(1),
@@ -70,14 +84,32 @@ public:
 		
 	}
 
+	int playerToMove() const
+	{
+		return player_to_move;
+	}
+
+	ZobristHash zobrist() const
+	{
+		return static_cast<ZobristHash>(3 * (winner + 1) + player_to_move);
+	}
+
 	bool has_moves() const
 	{
 		return winner < 0;
 	}
 
-	std::vector<Move> get_moves() const
+	void simulate()
 	{
-		std::vector<Move> moves;
+		static thread_local std::mt19937_64 engine(4711);
+		while (has_moves()) {
+			do_random_move(&engine);
+		}
+	}
+
+	Moves get_moves() const
+	{
+		Moves moves;
 		if ( ! has_moves()) {
 			return moves;
 		}
@@ -97,19 +129,20 @@ public:
 		return moves;
 	}
 
-	double get_result(int current_player_to_move) const
+	// In half points.
+	int get_result(int current_player_to_move) const
 	{
 		attest(winner >= 0);
 
 		if (winner == 0) {
-			return 0.5;
+			return 1;
 		}
 
 		if (winner == current_player_to_move) {
-			return 0.0;
+			return 0;
 		}
 		else {
-			return 1.0;
+			return 2;
 		}
 	}
 
@@ -122,27 +155,769 @@ private:
 TEST_CASE("dummy1")
 {
 	TestGame state(1);
-	auto move = MCTS::compute_move(state);
+	auto move = Mcts::compute_move(state);
 	CHECK(move == 2);
 }
 
 TEST_CASE("dummy2")
 {
 	TestGame state(2);
-	auto move = MCTS::compute_move(state);
+	auto move = Mcts::compute_move(state);
 	CHECK(move == 1);
 }
 
 TEST_CASE("Nim")
 {
-	MCTS::ComputeOptions options;
+	Mcts::ComputeOptions options;
+	options.max_iterations = 100000;
+
+	for (int chips = 4; chips <= 21; ++chips) {
+		if (chips % 4 != 0) {
+			NimState state(chips);
+			auto move = Mcts::compute_move(state, options);
+			CHECK(move == chips % 4);
+		}
+	}
+}
+
+TEST_CASE("Nim_tree_parallelization")
+{
+	Mcts::ComputeOptions options;
+	options.max_iterations = 100000;
+	options.parallelization = Mcts::Parallelization::tree;
+
+	for (int chips = 4; chips <= 21; ++chips) {
+		if (chips % 4 != 0) {
+			NimState state(chips);
+			auto move = Mcts::compute_move(state, options);
+			CHECK(move == chips % 4);
+		}
+	}
+}
+
+TEST_CASE("Nim_tree_reuse")
+{
+	Mcts::ComputeOptions options;
+	options.max_iterations = 10000;
+
+	Mcts::Search<NimState> search;
+	NimState state(13);
+	auto move = search.compute_move(state, options);
+	CHECK(move == 1);
+	state.do_move(move);
+	search.do_move(move);
+	CHECK(search.games() > 0);
+
+	state.do_move(2);
+	CHECK(search.reroot(state));
+	CHECK(search.games() > 0);
+	CHECK(search.compute_move(state, options) == 2);
+}
+
+TEST_CASE("Nim_arena_allocation")
+{
+	Mcts::ComputeOptions options;
+	options.max_iterations = 100000;
+
+	for (int chips = 4; chips <= 21; ++chips) {
+		if (chips % 4 != 0) {
+			NimState state(chips);
+			auto move = Mcts::compute_move<NimState, Mcts::ArenaAllocation>(state, options);
+			CHECK(move == chips % 4);
+		}
+	}
+}
+
+TEST_CASE("Nim_transpositions")
+{
+	Mcts::ComputeOptions options;
+	options.max_iterations = 100000;
+	options.transpositions = true;
+
+	for (auto parallelization : {Mcts::Parallelization::root, Mcts::Parallelization::tree}) {
+		options.parallelization = parallelization;
+		for (int chips = 4; chips <= 21; ++chips) {
+			if (chips % 4 != 0) {
+				NimState state(chips);
+				auto move = Mcts::compute_move<NimState, Mcts::ArenaAllocation>(state, options);
+				CHECK(move == chips % 4);
+			}
+		}
+	}
+}
+
+TEST_CASE("Nim_transposition_table")
+{
+	Mcts::ComputeOptions options;
+	options.max_iterations = 100000;
+	options.transposition_table_bytes = 1 << 20;
+
+	for (int chips = 4; chips <= 21; ++chips) {
+		if (chips % 4 != 0) {
+			NimState state(chips);
+			auto move = Mcts::compute_move(state, options);
+			CHECK(move == chips % 4);
+		}
+	}
+
+	Mcts::TranspositionTable<std::uint64_t> table(1000);
+	CHECK(table.size() == 32);
+	CHECK(table.update(4711, 2));
+	CHECK(table.update(4711, 1));
+	CHECK(table.find(4711)->visits == 2);
+	CHECK(table.find(4711)->wins == 3);
+	CHECK(table.find(4712) == nullptr);
+}
+
+TEST_CASE("Nim_deadline")
+{
+	Mcts::ComputeOptions options;
+	options.max_iterations = -1;
+	options.max_time = 0.05f;
+	options.verbose = false;
+
+	double const start = Mcts::wall_time();
+	auto tree = Mcts::compute_tree(NimState(21), options, 4711);
+	double const elapsed = Mcts::wall_time() - start;
+	CHECK(elapsed >= options.max_time);
+	// Generous, the tolerance does not cover being scheduled out.
+	CHECK(elapsed < options.max_time + 0.05);
+	CHECK(tree.root()->visits > 1);
+}
+
+TEST_CASE("Nim_ponder")
+{
+	Mcts::ComputeOptions options;
+	options.max_iterations = 10000;
+	options.verbose = false;
+	Mcts::ComputeOptions ponder_options = options;
+	ponder_options.max_iterations = -1;
+
+	Mcts::Search<NimState> search;
+	NimState state(15);
+	search.ponder(state, ponder_options);
+	CHECK(search.pondering());
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	state.do_move(2);
+	// The subtree of the opponent's move is kept.
+	CHECK(search.compute_move(state, options) == 1);
+	CHECK(not search.pondering());
+	CHECK(search.games() > 4 * options.max_iterations);
+}
+
+TEST_CASE("Nim_search_handle")
+{
+	Mcts::ComputeOptions options;
+	options.max_iterations = -1;
+	options.max_time = 60.0f;
+
+	Mcts::SearchHandle<NimState> handle(NimState(15), options);
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	CHECK(not handle.done());
+	CHECK(handle.statistics().size() > 0);
+
+	// Stopped from another thread, long before the budget runs out.
+	double const start = Mcts::wall_time();
+	std::thread([&handle] { handle.stop(); }).join();
+	CHECK(handle.wait() == 3);
+	CHECK(handle.done());
+	double const elapsed = Mcts::wall_time() - start;
+	CHECK(elapsed < 1.0);
+
+	auto const games = handle.games();
+	options.max_time = 0.05f;
+	handle.extend(options);
+	handle.wait();
+	CHECK(handle.games() > games);
+}
+
+TEST_CASE("Nim_progressive_widening")
+{
+	Mcts::ComputeOptions options;
+	options.max_iterations = 100000;
+	options.widening_constant = 0.5f;
+
+	for (int chips = 4; chips <= 21; ++chips) {
+		if (chips % 4 != 0) {
+			NimState state(chips);
+			auto move = Mcts::compute_move(state, options);
+			CHECK(move == chips % 4);
+		}
+	}
+
+	// 0.1 * sqrt(50) < 1, the root keeps a single child.
+	options.max_iterations = 50;
+	options.widening_constant = 0.1f;
+	auto tree = Mcts::compute_tree(NimState(21), options, 4711);
+	CHECK(tree.root()->children.size() == 1);
+}
+
+TEST_CASE("Nim_rave")
+{
+	static_assert(Mcts::records_playouts<NimState>::value, "NimState records its playouts");
+	Mcts::ComputeOptions options;
+	options.max_iterations = 100000;
+	options.rave_equivalence = 10.0f;
+
+	for (auto parallelization : {Mcts::Parallelization::root, Mcts::Parallelization::tree}) {
+		options.parallelization = parallelization;
+		for (int chips = 4; chips <= 21; ++chips) {
+			if (chips % 4 != 0) {
+				NimState state(chips);
+				auto move = Mcts::compute_move(state, options);
+				CHECK(move == chips % 4);
+			}
+		}
+	}
+
+	options.max_iterations = 1000;
+	auto tree = Mcts::compute_tree(NimState(10), options, 4711);
+	CHECK(tree.root()->has_amaf());
+}
+
+TEST_CASE("Nim_solver")
+{
+	Mcts::ComputeOptions options;
+	options.max_iterations = 100000;
+	options.solver = true;
+
+	for (auto parallelization : {Mcts::Parallelization::root, Mcts::Parallelization::tree}) {
+		options.parallelization = parallelization;
+		for (int chips = 4; chips <= 21; ++chips) {
+			if (chips % 4 != 0) {
+				NimState state(chips);
+				auto move = Mcts::compute_move(state, options);
+				CHECK(move == chips % 4);
+			}
+		}
+	}
+
+	// The player to move wins, so the player who moved into the root loses. The
+	// search stops as soon as that is proven.
+	options.max_iterations = 1000000;
+	auto tree = Mcts::compute_tree(NimState(10), options, 4711);
+	CHECK(tree.root()->proof.load() == Mcts::Proof::loss);
+	CHECK(tree.root()->visits < options.max_iterations);
+
+	// With transpositions, nodes are also proven through their other parents.
+	options.transpositions = true;
+	auto dag = Mcts::compute_tree<NimState, Mcts::ArenaAllocation>(NimState(13), options, 4711);
+	CHECK(dag.root()->proof.load() == Mcts::Proof::loss);
+	CHECK(dag.root()->visits < options.max_iterations);
+
+	options.max_iterations = 100000;
+	for (int chips = 5; chips <= 21; ++chips) {
+		if (chips % 4 != 0) {
+			auto proven = Mcts::compute_tree<NimState, Mcts::ArenaAllocation>(NimState(chips), options, 4711);
+			CHECK(proven.root()->proof.load() == Mcts::Proof::loss);
+			auto move = Mcts::compute_move<NimState, Mcts::ArenaAllocation>(NimState(chips), options);
+			CHECK(move == chips % 4);
+		}
+	}
+}
+
+TEST_CASE("Nim_memory_budget")
+{
+	Mcts::ComputeOptions options;
+	options.max_iterations = 100000;
+	options.max_memory_bytes = 100000;
+
+	// The tree stops growing at the budget (give or take a node), the search goes on.
+	auto tree = Mcts::compute_tree(NimState(30), options, 4711);
+	CHECK(tree.bytes() < options.max_memory_bytes + 1000);
+	CHECK(tree.root()->visits == options.max_iterations);
+
+	auto arena_tree = Mcts::compute_tree<NimState, Mcts::ArenaAllocation>(NimState(30), options, 4711);
+	CHECK(arena_tree.bytes() < options.max_memory_bytes + 1000);
+
+	// Nim 13 under about a tenth of the tree it grows unbounded: the budget is used
+	// up, and the statistics that keep coming in still find the move.
+	options.max_iterations = 200000;
+	options.max_memory_bytes = 30000;
+	for (auto parallelization : {Mcts::Parallelization::root, Mcts::Parallelization::tree}) {
+		options.parallelization = parallelization;
+		Mcts::Trees<NimState, Mcts::HeapAllocation> trees;
+		Mcts::default_engine().grow(trees, NimState(13), options);
+		std::size_t bytes = 0;
+		for (auto& budget_tree : trees) {
+			bytes += budget_tree.bytes();
+		}
+		CHECK(bytes >= options.max_memory_bytes);
+		CHECK(bytes < options.max_memory_bytes + 1000);
+		CHECK(Mcts::best_move(Mcts::root_statistics(trees), NimState::no_move) == 1);
+	}
+}
+
+TEST_CASE("Nim_compact_tree")
+{
+	Mcts::ComputeOptions options;
 	options.max_iterations = 100000;
 
 	for (int chips = 4; chips <= 21; ++chips) {
 		if (chips % 4 != 0) {
 			NimState state(chips);
-			auto move = MCTS::compute_move(state, options);
+			auto move = Mcts::compute_compact_move(state, options);
 			CHECK(move == chips % 4);
 		}
 	}
+
+	auto tree = Mcts::compute_compact_tree(NimState(21), options, 4711);
+	CHECK(tree[tree.root()].visits == options.max_iterations);
+
+	// The tree stops growing at the budget, the store only takes what the last
+	// expansion (at most three children) needs beyond it.
+	options.max_memory_bytes = 16000;
+	auto bounded = Mcts::compute_compact_tree(NimState(30), options, 4711);
+	std::size_t const used = bounded.size() * sizeof(Mcts::CompactNode);
+	std::size_t const cap = options.max_memory_bytes + 3 * sizeof(Mcts::CompactNode);
+	CHECK(used >= options.max_memory_bytes);
+	CHECK(bounded.bytes() <= cap);
+
+	// A small tree doesn't take the whole budget.
+	options.max_memory_bytes = 1 << 20;
+	auto small = Mcts::compute_compact_tree(NimState(5), options, 4711);
+	CHECK(small.bytes() < options.max_memory_bytes / 100);
+}
+
+TEST_CASE("Nim_tree_file")
+{
+	Mcts::ComputeOptions options;
+	options.max_iterations = 10000;
+	NimState state(17);
+
+	auto tree = Mcts::compute_tree(state, options, 4711);
+	Mcts::save_tree("nim_tree.bin", tree);
+	{
+		Mcts::MappedTree mapped("nim_tree.bin");
+		CHECK(mapped.root_hash() == tree.root()->hash);
+		CHECK(mapped[mapped.root()].visits == options.max_iterations);
+		auto statistics = Mcts::root_statistics<NimState::Move>(mapped);
+		REQUIRE(statistics.size() == tree.root()->children.size());
+		for (std::size_t i = 0; i < statistics.size(); ++i) {
+			CHECK(statistics[i].move == tree.root()->child_moves[i]);
+			CHECK(statistics[i].visits == tree.root()->child_visits[i]);
+		}
+	}
+
+	// A compact tree seeded from the file continues where the search left off.
+	auto compact = Mcts::compute_compact_tree(state, options, 4711);
+	Mcts::save_tree("nim_tree.bin", compact, state.zobrist());
+	{
+		Mcts::MappedTree mapped("nim_tree.bin");
+		REQUIRE(mapped.size() == compact.size());
+		Mcts::CompactTree<NimState> seeded(mapped.data(), mapped.size());
+		Mcts::grow_compact_tree(seeded, state, options, 4712);
+		CHECK(seeded[seeded.root()].visits == 2 * options.max_iterations);
+	}
+	std::remove("nim_tree.bin");
+
+	CHECK_THROWS(Mcts::MappedTree("no_such_tree.bin"));
+}
+
+TEST_CASE("Nim_opening_book")
+{
+	Mcts::ComputeOptions options;
+	options.max_iterations = 20000;
+
+	auto entries = Mcts::build_opening_book(NimState(10), 2, options);
+	Mcts::write_opening_book("nim.book", entries);
+	{
+		Mcts::OpeningBook book("nim.book");
+		CHECK(book.size() == entries.size());
+		REQUIRE(book.best(NimState(10).zobrist()) != nullptr);
+		CHECK(book.best(NimState(10).zobrist())->move == 2);
+		CHECK(book.best(NimState(30).zobrist()) == nullptr);
+
+		// Answered from the book, the budget is not touched.
+		options.book = &book;
+		options.max_iterations = -1;
+		options.max_time = 60.0;
+		CHECK(Mcts::compute_move(NimState(10), options) == 2);
+	}
+	std::remove("nim.book");
+
+	CHECK(Mcts::OpeningBook().best(0) == nullptr);
+	CHECK_THROWS(Mcts::OpeningBook("no_such.book"));
+}
+
+TEST_CASE("ConnectFour_opening_book")
+{
+	using State = ConnectFourState<6, 7>;
+	Mcts::ComputeOptions options;
+	options.max_iterations = 2000;
+
+	// The empty board and the seven positions after it, seven moves each.
+	auto entries = Mcts::build_opening_book(State(), 1, options);
+	CHECK(entries.size() == 8 * 7);
+	Mcts::write_opening_book("connect_four.book", entries);
+	{
+		Mcts::OpeningBook book("connect_four.book");
+		CHECK(book.size() == entries.size());
+		auto const * best = book.best(State().zobrist());
+		REQUIRE(best != nullptr);
+		for (auto move : State().get_moves()) {
+			State state;
+			state.do_move(move);
+			CHECK(book.best(state.zobrist()) != nullptr);
+		}
+
+		options.book = &book;
+		options.max_iterations = -1;
+		options.max_time = 60.0;
+		CHECK(Mcts::compute_move(State(), options) == best->move);
+	}
+	std::remove("connect_four.book");
+}
+
+TEST_CASE("Nim_merge_grandchildren")
+{
+	Mcts::ComputeOptions options;
+	options.max_iterations = 100000;
+	options.merge_grandchildren = true;
+
+	for (auto parallelization : {Mcts::Parallelization::root, Mcts::Parallelization::tree}) {
+		options.parallelization = parallelization;
+		for (int chips = 4; chips <= 21; ++chips) {
+			if (chips % 4 != 0) {
+				NimState state(chips);
+				auto move = Mcts::compute_move(state, options);
+				CHECK(move == chips % 4);
+			}
+		}
+	}
+}
+
+// Prefers the winning move in Nim, and counts the batches.
+class NimPriors : public Mcts::PriorEvaluator<NimState>
+{
+public:
+	void evaluate(Mcts::LeafBatch<NimState>& batch) override
+	{
+		++batches;
+		leaves += int(batch.size());
+		for (std::size_t i = 0; i < batch.size(); ++i) {
+			for (std::size_t m = batch.offsets[i]; m < batch.offsets[i + 1]; ++m) {
+				batch.priors[m] = batch.moves[m] == batch.states[i].chips % 4 ? 10.0f : 1.0f;
+			}
+		}
+	}
+
+	std::atomic<int> batches{0};
+	std::atomic<int> leaves{0};
+};
+
+TEST_CASE("Nim_puct")
+{
+	Mcts::ComputeOptions options;
+	options.max_iterations = 2000;
+	options.evaluator_batch_size = 8;
+
+	for (auto parallelization : {Mcts::Parallelization::root, Mcts::Parallelization::tree}) {
+		NimPriors priors;
+		options.evaluator = &priors;
+		options.parallelization = parallelization;
+		for (int chips = 5; chips <= 21; ++chips) {
+			if (chips % 4 != 0) {
+				NimState state(chips);
+				auto move = Mcts::compute_move(state, options);
+				CHECK(move == chips % 4);
+			}
+		}
+		// The evaluator saw several leaves per call.
+		CHECK(priors.leaves > 2 * priors.batches);
+	}
+
+	NimPriors priors;
+	options.evaluator = &priors;
+	auto tree = Mcts::compute_tree(NimState(17), options, 4711);
+	CHECK(tree.root()->visits == 2000);
+	CHECK(tree.root()->has_priors());
+}
+
+// The default policies, counting the playouts and the backups.
+struct CountingPolicies : Mcts::DefaultPolicies
+{
+	template<typename State, typename Allocation>
+	static void playout(State& state, Mcts::SearchContext<State, Allocation>& context)
+	{
+		++playouts;
+		Mcts::DefaultPolicies::playout(state, context);
+	}
+
+	template<typename State, typename Allocation>
+	static int backup(Mcts::Node<State, Allocation>& parent, std::int32_t slot, Mcts::Node<State, Allocation>& child,
+	                  State const& state, int virtual_loss) noexcept
+	{
+		++backups;
+		return Mcts::DefaultPolicies::backup(parent, slot, child, state, virtual_loss);
+	}
+
+	static inline std::atomic<int> playouts{0};
+	static inline std::atomic<int> backups{0};
+};
+
+TEST_CASE("Nim_puct_tree_reuse")
+{
+	// The priors move with the trees into new arenas, as the search follows the game.
+	Mcts::ComputeOptions options;
+	options.max_iterations = 2000;
+	options.verbose = false;
+	NimPriors priors;
+	options.evaluator = &priors;
+
+	Mcts::Search<NimState, Mcts::ArenaAllocation> search;
+	NimState state(21);
+	while (state.has_moves()) {
+		int const chips = state.chips;
+		auto move = search.compute_move(state, options);
+		if (chips % 4 != 0) {
+			CHECK(move == chips % 4);
+		}
+		state.do_move(move);
+		search.do_move(move);
+		if (state.has_moves()) {
+			CHECK(search.games() > 0);
+		}
+	}
+}
+
+TEST_CASE("Nim_policies")
+{
+	Mcts::ComputeOptions options;
+	options.max_iterations = 10000;
+	options.number_of_threads = 1;
+
+	auto tree = Mcts::compute_tree<NimState, Mcts::HeapAllocation, CountingPolicies>(NimState(21), options, 4711);
+	CHECK(CountingPolicies::playouts == 10000);
+	CHECK(CountingPolicies::backups >= 10000);
+	CHECK(tree.root()->visits == 10000);
+
+	options.number_of_threads = 4;
+	options.max_iterations = 100000;
+	Mcts::Search<NimState, Mcts::ArenaAllocation, CountingPolicies> search;
+	for (int chips = 5; chips <= 21; ++chips) {
+		if (chips % 4 != 0) {
+			search.clear();
+			auto move = search.compute_move(NimState(chips), options);
+			CHECK(move == chips % 4);
+		}
+	}
+}
+
+TEST_CASE("Nim_profile")
+{
+	Mcts::ComputeOptions options;
+	options.max_iterations = 10000;
+	options.number_of_threads = 1;
+	options.verbose = false;
+	Mcts::SearchProfile profile;
+	options.profile = &profile;
+
+	auto tree = Mcts::compute_tree<NimState>(NimState(21), options, 4711);
+#if MCTS_PROFILE
+	CHECK(profile.iterations == 10000);
+	CHECK(profile.average_depth() > 1.0);
+	CHECK(profile.average_playout_length() > 1.0);
+	CHECK(profile.nodes > 0);
+	CHECK(profile.nodes < 10000);
+	CHECK(profile.bytes > static_cast<std::int64_t>(tree.bytes()) / 2);
+	CHECK(profile.bytes < static_cast<std::int64_t>(tree.bytes()));
+	CHECK(profile.seconds[Mcts::SearchProfile::selection] > 0.0);
+	CHECK(profile.seconds[Mcts::SearchProfile::expansion] > 0.0);
+	CHECK(profile.seconds[Mcts::SearchProfile::evaluation] == 0.0);
+	CHECK(profile.seconds[Mcts::SearchProfile::simulation] > 0.0);
+	CHECK(profile.seconds[Mcts::SearchProfile::backpropagation] > 0.0);
+
+	// The threads add to the profile.
+	profile = Mcts::SearchProfile();
+	options.number_of_threads = 4;
+	Mcts::compute_move(NimState(21), options);
+	CHECK(profile.iterations == 4 * 10000);
+#else
+	CHECK(profile.iterations == 0);
+#endif
+}
+
+TEST_CASE("Nim_perft")
+{
+	// Every game from 5 chips: the compositions of 5 into parts of 1 to 3.
+	auto counts = Mcts::perft(NimState(5), 10);
+	CHECK(counts.nodes == 1 + 2 + 4 + 7 + 13);
+	CHECK(counts.leaves == 0);
+	CHECK(counts.terminals == 13);
+
+	counts = Mcts::perft(NimState(21), 3);
+	CHECK(counts.nodes == 3 + 9 + 27);
+	CHECK(counts.leaves == 27);
+	CHECK(counts.terminals == 0);
+	for (int threads = 2; threads <= 8; threads *= 2) {
+		CHECK(Mcts::perft(NimState(21), 3, threads) == counts);
+		CHECK(Mcts::perft(NimState(12), 12, threads) == Mcts::perft(NimState(12), 12));
+	}
+	CHECK(Mcts::perft(NimState(21), 0, 4).leaves == 1);
+}
+
+#ifndef _WIN32
+TEST_CASE("Nim_distributed")
+{
+	// Two worker processes on loopback, and a third worker that is not there.
+	std::vector<Mcts::Listener> listeners(2);
+	std::vector<pid_t> workers;
+	for (auto& listener : listeners) {
+		pid_t const pid = fork();
+		if (pid == 0) {
+			Mcts::Engine engine(2, false);
+			Mcts::serve_searches<NimState>(listener, engine, 2);
+			_exit(0);
+		}
+		workers.push_back(pid);
+	}
+	std::vector<Mcts::WorkerAddress> addresses;
+	for (auto& listener : listeners) {
+		addresses.push_back({"127.0.0.1", listener.port()});
+		listener.close();
+	}
+	{
+		Mcts::Listener gone;
+		addresses.push_back({"localhost", gone.port()});
+	}
+
+	Mcts::ComputeOptions options;
+	options.max_iterations = 50000;
+	options.number_of_threads = 2;
+	CHECK(Mcts::compute_move_distributed(NimState(13), options, addresses, 2) == 1);
+	// Only the workers search.
+	options.number_of_threads = 0;
+	CHECK(Mcts::compute_move_distributed(NimState(14), options, addresses, 2) == 2);
+
+	for (pid_t pid : workers) {
+		int status = 0;
+		waitpid(pid, &status, 0);
+		CHECK(WIFEXITED(status));
+	}
+	// No worker left, the move is searched here.
+	CHECK(Mcts::compute_move_distributed(NimState(15), options, addresses, 2) == 3);
+}
+
+TEST_CASE("Nim_distributed_bad_response")
+{
+	// A worker that answers with more moves than the root has, all of them a move
+	// that doesn't exist and with many visits.
+	Mcts::Listener listener;
+	pid_t const pid = fork();
+	if (pid == 0) {
+		Mcts::Socket socket = listener.accept();
+		Mcts::SearchRequest request;
+		socket.receive(&request, sizeof(request));
+		NimState state(0);
+		socket.receive(&state, sizeof(state));
+		Mcts::SearchResponse const response{Mcts::SearchRequest::magic_number, 1000};
+		std::vector<Mcts::WireMoveStatistics> moves(1000, Mcts::WireMoveStatistics{99, 1000000, 2000000.0f, 0});
+		socket.send(&response, sizeof(response));
+		socket.send(moves.data(), moves.size() * sizeof(Mcts::WireMoveStatistics));
+		_exit(0);
+	}
+	std::vector<Mcts::WorkerAddress> addresses{{"127.0.0.1", listener.port()}};
+	listener.close();
+
+	Mcts::ComputeOptions options;
+	options.max_iterations = 50000;
+	options.number_of_threads = 2;
+	CHECK(Mcts::compute_move_distributed(NimState(13), options, addresses, 2) == 1);
+	int status = 0;
+	waitpid(pid, &status, 0);
+	CHECK(WIFEXITED(status));
+}
+#endif
+
+TEST_CASE("move_merge")
+{
+	// Negative and spread out moves, the table is reused.
+	Mcts::MoveMerge<int> merge;
+	for (int round = 0; round < 3; ++round) {
+		merge.clear();
+		for (int i = 0; i < 1000; ++i) {
+			auto& statistics = merge[(i * 7919) % 500 - 250];
+			statistics.visits += 1;
+			statistics.wins += 0.5f;
+		}
+		auto& statistics = merge.sorted();
+		REQUIRE(statistics.size() == 500);
+		for (std::size_t i = 0; i < statistics.size(); ++i) {
+			CHECK(statistics[i].move == int(i) - 250);
+			CHECK(statistics[i].visits == 2);
+			CHECK(statistics[i].wins == 1.0f);
+		}
+	}
+}
+
+TEST_CASE("uct_kernel")
+{
+	// The vectorized kernel must pick the same child as a plain scan.
+	std::mt19937 engine(4711);
+	for (int n = 1; n <= 100; ++n) {
+		std::vector<std::int32_t> visits(n);
+		std::vector<float> wins(n);
+		for (int i = 0; i < n; ++i) {
+			visits[i] = engine() % 1000 + 1;
+			wins[i] = float(engine() % (2 * visits[i] + 1));
+		}
+		int const parent_visits = 100 * n;
+		float const two_log_n = 2.0f * std::log(float(parent_visits));
+		int best = 0;
+		for (int i = 1; i < n; ++i) {
+			if (Mcts::uct_score(visits[i], wins[i], two_log_n) > Mcts::uct_score(visits[best], wins[best], two_log_n)) {
+				best = i;
+			}
+		}
+		CHECK(Mcts::select_uct(visits.data(), wins.data(), n, parent_visits) == best);
+	}
+}
+
+TEST_CASE("arena_blocks")
+{
+	// A bound arena maps its blocks itself, a large request gets a block of its own.
+	Mcts::Arena arena;
+	arena.bind(0);
+	char * small = arena.allocate<char>(100);
+	char * large = arena.allocate<char>(3 * Mcts::Arena::block_size);
+	std::fill(small, small + 100, 1);
+	std::fill(large, large + 3 * Mcts::Arena::block_size, 2);
+	CHECK(arena.bytes() >= 4 * Mcts::Arena::block_size);
+	CHECK(small[99] == 1);
+	CHECK(large[3 * Mcts::Arena::block_size - 1] == 2);
+	arena.clear();
+	CHECK(arena.bytes() == 0);
+}
+
+TEST_CASE("thread_pool_placement")
+{
+	auto compact = Mcts::ThreadPool::cores(Mcts::Placement::compact);
+	auto scatter = Mcts::ThreadPool::cores(Mcts::Placement::scatter);
+	REQUIRE(compact.size() == scatter.size());
+	REQUIRE(!compact.empty());
+	// Compact keeps the cores of a node together, scatter deals them out over the nodes.
+	for (std::size_t i = 1; i < compact.size(); ++i) {
+		CHECK(compact[i - 1].node <= compact[i].node);
+	}
+	CHECK(scatter.front().cpu == compact.front().cpu);
+
+	for (auto placement : {Mcts::Placement::none, Mcts::Placement::compact, Mcts::Placement::scatter}) {
+		Mcts::Engine engine(4, placement);
+		for (int worker = 0; worker < 4; ++worker) {
+			CHECK((engine.thread_pool().numa_node(worker) >= 0) == (placement != Mcts::Placement::none));
+		}
+		// A task knows the node it runs on, wherever it was stolen to.
+		CHECK(engine.thread_pool().this_numa_node() == -1);
+		int const node = engine.thread_pool().submit_to(0, [&engine] { return engine.thread_pool().this_numa_node(); }).get();
+		CHECK((node >= 0) == (placement != Mcts::Placement::none));
+		Mcts::ComputeOptions options;
+		options.number_of_threads = 4;
+		options.max_iterations = 100000;
+		for (auto parallelization : {Mcts::Parallelization::root, Mcts::Parallelization::tree}) {
+			options.parallelization = parallelization;
+			auto move = engine.compute_move<NimState, Mcts::ArenaAllocation>(NimState(13), options);
+			CHECK(move == 1);
+		}
+	}
 }
@@ -0,0 +1,310 @@
+//
+// MIT License.
+//
+// degski 2020
+// degski@gmail.com
+//
+// A persistent work-stealing thread pool.
+//
+// Every worker owns a task deque. Workers pop their own tasks from the back
+// and, when they run dry, steal from the front of the other workers' deques.
+// Tasks submitted from outside the pool are dealt out round-robin, or queued
+// with the worker they are submitted to. Workers are (optionally) pinned to a core
+// and live until the pool is destroyed, so the search threads are reused
+// across moves and games.
+//
+// The cores are handed out in the order of a Placement over the NUMA nodes
+// the process may run on (on Linux read from /sys, on Windows asked for, one
+// node elsewhere).
+//
+
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined( _WIN32 )
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <windows.h>
+#elif defined( __linux__ )
+#    include <dirent.h>
+#    include <pthread.h>
+#    include <sched.h>
+#    include <cstdio>
+#    include <cstdlib>
+#    include <string>
+#endif
+
+namespace Mcts {
+
+// Where the workers of a pool run.
+//   none:    wherever the OS puts them.
+//   compact: the cores of one NUMA node first, then those of the next node.
+//   scatter: the NUMA nodes take turns, so the workers (and the memory
+//            bandwidth they use) are spread over the sockets.
+enum class Placement : std::int8_t { none, compact, scatter };
+
+class ThreadPool {
+
+    public:
+    using Task = std::function<void ( )>;
+
+    // The pool never grows beyond this many workers.
+    static constexpr int max_threads = 256;
+
+    // A core, and the NUMA node it belongs to.
+    struct Core {
+        int cpu;
+        int node;
+    };
+
+    explicit ThreadPool ( int number_of_threads_ = 0, Placement placement_ = Placement::compact ) :
+        workers ( new Worker[ max_threads ] ), placement ( placement_ ),
+        order ( placement_ == Placement::none ? std::vector<Core> ( ) : cores ( placement_ ) ) {
+        reserve ( number_of_threads_ > 0 ? number_of_threads_ : hardware_threads ( ) );
+    }
+    ThreadPool ( int number_of_threads_, bool pin_threads_ ) :
+        ThreadPool ( number_of_threads_, pin_threads_ ? Placement::compact : Placement::none ) {}
+
+    ThreadPool ( ThreadPool const & ) = delete;
+    ThreadPool & operator= ( ThreadPool const & ) = delete;
+
+    ~ThreadPool ( ) noexcept {
+        {
+            std::lock_guard<std::mutex> lock ( idle_mutex );
+            stopping = true;
+        }
+        idle.notify_all ( );
+        for ( int i = 0, n = size ( ); i < n; ++i )
+            workers[ i ].thread.join ( );
+    }
+
+    int size ( ) const noexcept { return number_of_workers.load ( std::memory_order_acquire ); }
+
+    static int hardware_threads ( ) noexcept {
+        int const n = static_cast<int> ( std::thread::hardware_concurrency ( ) );
+        return n > 0 ? n : 1;
+    }
+
+    Placement placement_policy ( ) const noexcept { return placement; }
+    // The NUMA node worker_ is pinned to, -1 if it isn't pinned.
+    int numa_node ( int worker_ ) const noexcept { return workers[ worker_ % size ( ) ].node; }
+    // The NUMA node of the worker that calls it, -1 if that worker isn't pinned or
+    // the caller isn't a worker of this pool. A task asks where it actually runs.
+    int this_numa_node ( ) const noexcept { return this_pool == this ? workers[ this_worker ].node : -1; }
+
+    // The cores this process may run on, in the order of placement_.
+    static std::vector<Core> cores ( Placement placement_ );
+
+    // Starts workers until there are at least number_of_threads_ of them. The node
+    // of a worker is set before it starts, and it pins itself before it takes a task.
+    void reserve ( int number_of_threads_ ) {
+        std::lock_guard<std::mutex> lock ( grow_mutex );
+        int n = size ( );
+        for ( ; n < number_of_threads_ and n < max_threads; ++n ) {
+            int cpu = -1;
+            if ( not order.empty ( ) ) {
+                Core const & core = order[ n % order.size ( ) ];
+                workers[ n ].node = core.node;
+                cpu               = core.cpu;
+            }
+            workers[ n ].thread = std::thread ( [ this, n, cpu ] ( ) { run ( n, cpu ); } );
+        }
+        number_of_workers.store ( n, std::memory_order_release );
+    }
+
+    template<typename Function>
+    std::future<typename std::invoke_result<Function>::type> submit ( Function && function_ ) {
+        // Tasks submitted by a worker go to its own deque, the others are dealt out.
+        int const w = this_worker >= 0 and this_pool == this ? this_worker
+                                                             : next_worker.fetch_add ( 1, std::memory_order_relaxed ) % size ( );
+        return submit_to ( w, std::forward<Function> ( function_ ) );
+    }
+
+    // Queues the task with worker_. Any idle worker may be woken up for it and
+    // steal it, so worker_ is where the task prefers to run, not where it must.
+    template<typename Function>
+    std::future<typename std::invoke_result<Function>::type> submit_to ( int worker_, Function && function_ ) {
+        using Result = typename std::invoke_result<Function>::type;
+        auto task    = std::make_shared<std::packaged_task<Result ( )>> ( std::forward<Function> ( function_ ) );
+        auto future  = task->get_future ( );
+        int const w  = worker_ % size ( );
+        {
+            std::lock_guard<std::mutex> lock ( workers[ w ].mutex );
+            workers[ w ].tasks.emplace_back ( [ task ] ( ) { ( *task ) ( ); } );
+        }
+        {
+            std::lock_guard<std::mutex> lock ( idle_mutex );
+            ++pending;
+        }
+        idle.notify_one ( );
+        return future;
+    }
+
+    private:
+    struct Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::thread thread;
+        int node = -1;
+    };
+
+    bool pop ( int w_, Task & task_ ) {
+        std::lock_guard<std::mutex> lock ( workers[ w_ ].mutex );
+        if ( workers[ w_ ].tasks.empty ( ) )
+            return false;
+        task_ = std::move ( workers[ w_ ].tasks.back ( ) );
+        workers[ w_ ].tasks.pop_back ( );
+        return true;
+    }
+
+    bool steal ( int w_, Task & task_ ) {
+        for ( int i = 1, n = size ( ); i < n; ++i ) {
+            Worker & victim = workers[ ( w_ + i ) % n ];
+            std::lock_guard<std::mutex> lock ( victim.mutex );
+            if ( not victim.tasks.empty ( ) ) {
+                task_ = std::move ( victim.tasks.front ( ) );
+                victim.tasks.pop_front ( );
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Runs the tasks of worker w_, on cpu_ (anywhere if it is -1).
+    void run ( int w_, int cpu_ ) {
+        if ( cpu_ >= 0 )
+            pin ( cpu_ );
+        this_worker = w_;
+        this_pool   = this;
+        Task task;
+        while ( true ) {
+            {
+                std::unique_lock<std::mutex> lock ( idle_mutex );
+                idle.wait ( lock, [ this ] ( ) { return stopping or pending > 0; } );
+                if ( stopping and not pending )
+                    return;
+                --pending;
+            }
+            // A task is reserved for us, it's in some deque.
+            while ( not pop ( w_, task ) and not steal ( w_, task ) )
+                std::this_thread::yield ( );
+            task ( );
+            task = nullptr;
+        }
+    }
+
+    // Pins the calling thread to core_.
+    static void pin ( int core_ ) noexcept {
+#if defined( _WIN32 )
+        SetThreadAffinityMask ( GetCurrentThread ( ), DWORD_PTR{ 1 } << core_ );
+#elif defined( __linux__ )
+        cpu_set_t set;
+        CPU_ZERO ( &set );
+        CPU_SET ( core_, &set );
+        pthread_setaffinity_np ( pthread_self ( ), sizeof ( cpu_set_t ), &set );
+#else
+        ( void ) core_;
+#endif
+    }
+
+    std::unique_ptr<Worker[]> workers;
+    std::atomic<int> number_of_workers{ 0 };
+    std::atomic<unsigned> next_worker{ 0 };
+    std::mutex grow_mutex;
+    Placement placement;
+    std::vector<Core> order; // The cores the workers are pinned to, in turn.
+
+    std::mutex idle_mutex;
+    std::condition_variable idle;
+    int pending   = 0;
+    bool stopping = false;
+
+    static inline thread_local int this_worker              = -1;
+    static inline thread_local ThreadPool const * this_pool = nullptr;
+};
+
+inline std::vector<ThreadPool::Core> ThreadPool::cores ( Placement placement_ ) {
+    std::vector<Core> found;
+#if defined( _WIN32 )
+    for ( int cpu = 0; cpu < hardware_threads ( ) and cpu < 64; ++cpu ) {
+        UCHAR node = 0;
+        GetNumaProcessorNode ( static_cast<UCHAR> ( cpu ), &node );
+        found.push_back ( Core{ cpu, node == 0xff ? 0 : int{ node } } );
+    }
+#elif defined( __linux__ )
+    cpu_set_t allowed;
+    CPU_ZERO ( &allowed );
+    if ( sched_getaffinity ( 0, sizeof ( cpu_set_t ), &allowed ) != 0 )
+        for ( int cpu = 0; cpu < hardware_threads ( ); ++cpu )
+            CPU_SET ( cpu, &allowed );
+    // Every node lists its cpus as ranges, like 0-15,32-47.
+    if ( DIR * directory = opendir ( "/sys/devices/system/node" ) ) {
+        while ( dirent * entry = readdir ( directory ) ) {
+            int node = 0;
+            if ( std::sscanf ( entry->d_name, "node%d", &node ) != 1 )
+                continue;
+            std::string const path = std::string ( "/sys/devices/system/node/" ) + entry->d_name + "/cpulist";
+            if ( std::FILE * file = std::fopen ( path.c_str ( ), "r" ) ) {
+                int first = 0, last = 0;
+                while ( std::fscanf ( file, "%d", &first ) == 1 ) {
+                    last = first;
+                    int c = std::fgetc ( file );
+                    if ( c == '-' ) {
+                        if ( std::fscanf ( file, "%d", &last ) != 1 )
+                            break;
+                        c = std::fgetc ( file );
+                    }
+                    for ( int cpu = first; cpu <= last and cpu < CPU_SETSIZE; ++cpu )
+                        if ( CPU_ISSET ( cpu, &allowed ) )
+                            found.push_back ( Core{ cpu, node } );
+                    if ( c != ',' )
+                        break;
+                }
+                std::fclose ( file );
+            }
+        }
+        closedir ( directory );
+    }
+    // No NUMA information, one node of all allowed cpus.
+    if ( found.empty ( ) )
+        for ( int cpu = 0; cpu < CPU_SETSIZE; ++cpu )
+            if ( CPU_ISSET ( cpu, &allowed ) )
+                found.push_back ( Core{ cpu, 0 } );
+#endif
+    if ( found.empty ( ) )
+        for ( int cpu = 0; cpu < hardware_threads ( ); ++cpu )
+            found.push_back ( Core{ cpu, 0 } );
+    std::sort ( found.begin ( ), found.end ( ),
+                [] ( Core const & a, Core const & b ) noexcept { return a.node != b.node ? a.node < b.node : a.cpu < b.cpu; } );
+    if ( placement_ != Placement::scatter )
+        return found;
+    // Deal the cores of the nodes out in turn: the i-th core of every node, then the i + 1-th.
+    std::vector<Core> dealt;
+    dealt.reserve ( found.size ( ) );
+    std::vector<std::size_t> starts;
+    for ( std::size_t i = 0; i < found.size ( ); ++i )
+        if ( not i or found[ i ].node != found[ i - 1 ].node )
+            starts.push_back ( i );
+    starts.push_back ( found.size ( ) );
+    for ( std::size_t i = 0; dealt.size ( ) < found.size ( ); ++i )
+        for ( std::size_t n = 0; n + 1 < starts.size ( ); ++n )
+            if ( starts[ n ] + i < starts[ n + 1 ] )
+                dealt.push_back ( found[ starts[ n ] + i ] );
+    return dealt;
+}
+
+} // namespace Mcts
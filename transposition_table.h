@@ -0,0 +1,106 @@
+//
+// MIT License.
+//
+// degski 2020
+// degski@gmail.com
+//
+// A fixed-size, lock-free transposition table.
+//
+// Maps the Zobrist hash of a position to the visits and wins (in half points,
+// for the player who moved into the position) gathered for it by all threads.
+// Open addressing with linear probing over a short window, the key of an entry
+// is claimed with a CAS and never changes until the table is cleared. When the
+// window is full, the update is dropped: the table only adds information to the
+// trees, it's never the only place where statistics are kept.
+//
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace Mcts {
+
+template<typename ZobristHash>
+class TranspositionTable {
+
+    public:
+    struct Entry {
+        std::atomic<ZobristHash> key{ 0 };
+        std::atomic<std::int32_t> visits{ 0 };
+        std::atomic<std::int32_t> wins{ 0 };
+    };
+
+    // The number of entries that are probed for a key.
+    static constexpr std::size_t window = 8;
+
+    TranspositionTable ( ) noexcept = default;
+    explicit TranspositionTable ( std::size_t bytes_ ) { resize ( bytes_ ); }
+
+    // Sizes the table to the largest power of two number of entries that fits in
+    // bytes_, 0 disables the table. All entries are cleared if the size changes.
+    void resize ( std::size_t bytes_ ) {
+        std::size_t n = bytes_ / sizeof ( Entry ) >= window ? window : 0;
+        while ( n and n * 2 * sizeof ( Entry ) <= bytes_ )
+            n *= 2;
+        if ( n == size ( ) )
+            return;
+        entries.reset ( n ? new Entry[ n ] : nullptr );
+        mask = n ? n - 1 : 0;
+    }
+
+    // Not thread safe.
+    void clear ( ) noexcept {
+        for ( std::size_t i = 0, n = size ( ); i < n; ++i ) {
+            entries[ i ].key.store ( 0, std::memory_order_relaxed );
+            entries[ i ].visits.store ( 0, std::memory_order_relaxed );
+            entries[ i ].wins.store ( 0, std::memory_order_relaxed );
+        }
+    }
+
+    bool enabled ( ) const noexcept { return static_cast<bool> ( entries ); }
+    std::size_t size ( ) const noexcept { return entries ? mask + 1 : 0; }
+    std::size_t bytes ( ) const noexcept { return size ( ) * sizeof ( Entry ); }
+
+    // Returns nullptr if hash_ is not in the table.
+    Entry const * find ( ZobristHash hash_ ) const noexcept {
+        ZobristHash const key = to_key ( hash_ );
+        for ( std::size_t i = 0; i < window; ++i ) {
+            Entry const & entry = entries[ ( static_cast<std::size_t> ( key ) + i ) & mask ];
+            ZobristHash const k = entry.key.load ( std::memory_order_relaxed );
+            if ( k == key )
+                return &entry;
+            if ( not k )
+                return nullptr;
+        }
+        return nullptr;
+    }
+
+    // Adds a visit with result_ to hash_, returns false if the table has no room.
+    bool update ( ZobristHash hash_, int result_ ) noexcept {
+        ZobristHash const key = to_key ( hash_ );
+        for ( std::size_t i = 0; i < window; ++i ) {
+            Entry & entry = entries[ ( static_cast<std::size_t> ( key ) + i ) & mask ];
+            ZobristHash k = entry.key.load ( std::memory_order_relaxed );
+            if ( not k and entry.key.compare_exchange_strong ( k, key, std::memory_order_relaxed ) )
+                k = key;
+            if ( k == key ) {
+                entry.visits.fetch_add ( 1, std::memory_order_relaxed );
+                entry.wins.fetch_add ( result_, std::memory_order_relaxed );
+                return true;
+            }
+        }
+        return false;
+    }
+
+    private:
+    // 0 marks an empty entry.
+    static ZobristHash to_key ( ZobristHash hash_ ) noexcept { return hash_ ? hash_ : 1; }
+
+    std::unique_ptr<Entry[]> entries;
+    std::size_t mask = 0;
+};
+
+} // namespace Mcts
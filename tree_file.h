@@ -0,0 +1,139 @@
+//
+// MIT License.
+//
+// degski 2020
+// degski@gmail.com
+//
+// Saving search trees to disk and mapping them back.
+//
+// A tree file is a TreeFileHeader followed by the nodes of a CompactTree (see
+// compact_tree.h), in native byte order: node 0 is the root, the children of
+// a node are one contiguous block. A MappedTree maps a file read-only, the
+// nodes are used in place without being parsed or copied. A CompactTree can
+// be seeded from it to continue the search.
+//
+// save_tree converts a Node tree on the way out: the children of a node
+// become its block, followed by its untried moves (as unvisited children).
+// A node shared by transpositions has one block that all its edges point to.
+//
+
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "compact_tree.h"
+#include "mapped_file.h"
+#include "mcts.h"
+
+namespace Mcts {
+
+struct TreeFileHeader {
+    static constexpr char magic_bytes[ 8 ]     = { 'M', 'C', 'T', 'S', 'T', 'R', 'E', 'E' };
+    static constexpr std::uint32_t current_version = 1;
+
+    char magic[ 8 ];
+    std::uint32_t version;
+    std::uint32_t node_size; // sizeof ( CompactNode ), guards against a different layout.
+    std::uint64_t number_of_nodes;
+    std::uint64_t root_hash; // The Zobrist hash of the root position.
+
+    bool is_valid ( ) const noexcept {
+        return std::memcmp ( magic, magic_bytes, sizeof ( magic ) ) == 0 and version == current_version and
+               node_size == sizeof ( CompactNode );
+    }
+};
+
+static_assert ( sizeof ( TreeFileHeader ) == 32, "the header keeps the nodes 16 byte aligned" );
+
+// Writes header and nodes to path_, throws std::runtime_error on failure.
+inline void write_tree_file ( std::string const & path_, std::uint64_t root_hash_, CompactNode const * nodes_, std::size_t n_ ) {
+    TreeFileHeader header{ { }, TreeFileHeader::current_version, sizeof ( CompactNode ), n_, root_hash_ };
+    std::memcpy ( header.magic, TreeFileHeader::magic_bytes, sizeof ( header.magic ) );
+    std::unique_ptr<std::FILE, int ( * ) ( std::FILE * )> file ( std::fopen ( path_.c_str ( ), "wb" ), &std::fclose );
+    if ( not file or std::fwrite ( &header, sizeof ( header ), 1, file.get ( ) ) != 1 or
+         std::fwrite ( nodes_, sizeof ( CompactNode ), n_, file.get ( ) ) != n_ or std::fflush ( file.get ( ) ) )
+        throw std::runtime_error ( "cannot write tree file " + path_ );
+}
+
+template<typename State>
+void save_tree ( std::string const & path_, CompactTree<State> const & tree_, std::uint64_t root_hash_ ) {
+    write_tree_file ( path_, root_hash_, &tree_[ tree_.root ( ) ], tree_.size ( ) );
+}
+
+template<typename State, typename Allocation>
+void save_tree ( std::string const & path_, Tree<State, Allocation> const & tree_ ) {
+    using Node = typename Tree<State, Allocation>::Node;
+    std::vector<CompactNode> nodes ( 1, CompactNode{ tree_.root ( )->visits, 0.0f, 0, 0, 0 } );
+    // The nodes whose block is still to be written, breadth first, with their index.
+    std::vector<std::pair<Node const *, std::uint32_t>> queue ( 1, { tree_.root ( ), 0 } );
+    std::unordered_map<Node const *, std::uint32_t> blocks; // Transpositions share a block.
+    auto move16 = [] ( typename State::Move move_ ) {
+        check ( 0 <= move_ and move_ <= std::numeric_limits<std::uint16_t>::max ( ), "a move does not fit in a tree file" );
+        return static_cast<std::uint16_t> ( move_ );
+    };
+    for ( std::size_t q = 0; q < queue.size ( ); ++q ) {
+        auto const [ node, index ] = queue[ q ];
+        std::size_t const n        = node->children.size ( ) + node->moves.size ( );
+        check ( n <= std::numeric_limits<std::uint16_t>::max ( ), "a node has too many moves for a tree file" );
+        auto const [ block, added ] = blocks.emplace ( node, static_cast<std::uint32_t> ( nodes.size ( ) ) );
+        nodes[ index ].first_child        = block->second;
+        nodes[ index ].number_of_children = static_cast<std::uint16_t> ( n );
+        if ( not added )
+            continue;
+        for ( std::size_t i = 0; i < node->children.size ( ); ++i ) {
+            queue.emplace_back ( &*node->children[ i ], static_cast<std::uint32_t> ( nodes.size ( ) ) );
+            nodes.push_back ( CompactNode{ node->child_visits[ i ], node->child_wins[ i ], 0, 0, move16 ( node->child_moves[ i ] ) } );
+        }
+        for ( auto const & move : node->moves )
+            nodes.push_back ( CompactNode{ 0, 0.0f, 0, 0, move16 ( move ) } );
+    }
+    write_tree_file ( path_, tree_.root ( )->hash, nodes.data ( ), nodes.size ( ) );
+}
+
+// A tree file, mapped read-only. Throws std::runtime_error if the file can't be
+// mapped or is not a tree file of this version.
+class MappedTree {
+
+    public:
+    explicit MappedTree ( std::string const & path_ );
+
+    static constexpr std::uint32_t root ( ) noexcept { return 0; }
+
+    TreeFileHeader const & header ( ) const noexcept { return *reinterpret_cast<TreeFileHeader const *> ( file.data ( ) ); }
+    std::uint64_t root_hash ( ) const noexcept { return header ( ).root_hash; }
+    std::size_t size ( ) const noexcept { return static_cast<std::size_t> ( header ( ).number_of_nodes ); }
+    CompactNode const * data ( ) const noexcept {
+        return reinterpret_cast<CompactNode const *> ( file.data ( ) + sizeof ( TreeFileHeader ) );
+    }
+    CompactNode const & operator[] ( std::uint32_t i_ ) const noexcept { return data ( )[ i_ ]; }
+
+    private:
+    MappedFile file;
+};
+
+inline MappedTree::MappedTree ( std::string const & path_ ) : file ( path_ ) {
+    if ( file.size ( ) < sizeof ( TreeFileHeader ) or not header ( ).is_valid ( ) or
+         ( file.size ( ) - sizeof ( TreeFileHeader ) ) / sizeof ( CompactNode ) < header ( ).number_of_nodes )
+        throw std::runtime_error ( "not a tree file (of this version) " + path_ );
+}
+
+// The statistics of the root moves of a mapped tree, ordered as in the file.
+template<typename Move>
+std::vector<MoveStatistics<Move>> root_statistics ( MappedTree const & tree_ ) {
+    CompactNode const & root = tree_[ tree_.root ( ) ];
+    std::vector<MoveStatistics<Move>> statistics;
+    statistics.reserve ( root.number_of_children );
+    for ( std::uint32_t i = root.first_child; i < root.first_child + root.number_of_children; ++i )
+        statistics.push_back ( MoveStatistics<Move>{ static_cast<Move> ( tree_[ i ].move ), tree_[ i ].visits, tree_[ i ].wins, Proof::none } );
+    return statistics;
+}
+
+} // namespace Mcts
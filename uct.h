@@ -0,0 +1,124 @@
+//
+// MIT License.
+//
+// degski 2020
+// degski@gmail.com
+//
+// UCT child selection over structure-of-arrays child statistics.
+//
+// The visits and wins of all children of a node are stored contiguously in the
+// parent, and all children are scored in one pass, without writing anything,
+// keeping the running maximum in registers. AVX2 (8 lanes) or SSE2 (4 lanes)
+// are used when the compiler targets them, with a scalar fallback (and for
+// the tail). Wins are counted in half points (a win is 2, a draw is 1), hence
+// the 0.5.
+//
+// The score of child i is
+//
+//     wins[ i ] / 2 / visits[ i ] + sqrt ( 2 ln ( parent visits ) / visits[ i ] ),
+//
+// children without visits score FLT_MAX. Ties go to the lowest index.
+//
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+
+#if defined( __AVX2__ )
+#    include <immintrin.h>
+#elif defined( __SSE2__ ) or defined( _M_X64 ) or ( defined( _M_IX86_FP ) and _M_IX86_FP >= 2 )
+#    define MCTS_UCT_SSE2 1
+#    include <emmintrin.h>
+#endif
+
+namespace Mcts {
+
+inline float uct_score ( std::int32_t visits_, float wins_, float two_log_parent_visits_ ) noexcept {
+    if ( not visits_ )
+        return std::numeric_limits<float>::max ( );
+    float const inverse = 1.0f / static_cast<float> ( visits_ );
+    return 0.5f * wins_ * inverse + std::sqrt ( two_log_parent_visits_ * inverse );
+}
+
+// Returns the index of the child with the highest UCT score, n_ > 0.
+inline int select_uct ( std::int32_t const * visits_, float const * wins_, int n_, std::int32_t parent_visits_ ) noexcept {
+    float const two_log_n = 2.0f * std::log ( static_cast<float> ( parent_visits_ > 0 ? parent_visits_ : 1 ) );
+    int i = 0, best_index = 0;
+    float best_score = -std::numeric_limits<float>::max ( );
+
+#if defined( __AVX2__ )
+    if ( n_ >= 8 ) {
+        __m256 const half = _mm256_set1_ps ( 0.5f ), one = _mm256_set1_ps ( 1.0f ), zero = _mm256_setzero_ps ( );
+        __m256 const two_log = _mm256_set1_ps ( two_log_n ), unvisited = _mm256_set1_ps ( std::numeric_limits<float>::max ( ) );
+        __m256i const step = _mm256_set1_epi32 ( 8 );
+        __m256 lane_best   = _mm256_set1_ps ( -std::numeric_limits<float>::max ( ) );
+        __m256i lane_index = _mm256_setr_epi32 ( 0, 1, 2, 3, 4, 5, 6, 7 ), lane_best_index = lane_index;
+        for ( ; i + 8 <= n_; i += 8 ) {
+            __m256 const v       = _mm256_cvtepi32_ps ( _mm256_loadu_si256 ( reinterpret_cast<__m256i const *> ( visits_ + i ) ) );
+            __m256 const w       = _mm256_loadu_ps ( wins_ + i );
+            __m256 const inverse = _mm256_div_ps ( one, v );
+            __m256 score         = _mm256_add_ps ( _mm256_mul_ps ( _mm256_mul_ps ( half, w ), inverse ),
+                                           _mm256_sqrt_ps ( _mm256_mul_ps ( two_log, inverse ) ) );
+            score                = _mm256_blendv_ps ( score, unvisited, _mm256_cmp_ps ( v, zero, _CMP_EQ_OQ ) );
+            __m256 const better  = _mm256_cmp_ps ( score, lane_best, _CMP_GT_OQ );
+            lane_best            = _mm256_blendv_ps ( lane_best, score, better );
+            lane_best_index      = _mm256_castps_si256 ( _mm256_blendv_ps ( _mm256_castsi256_ps ( lane_best_index ),
+                                                                       _mm256_castsi256_ps ( lane_index ), better ) );
+            lane_index           = _mm256_add_epi32 ( lane_index, step );
+        }
+        alignas ( 32 ) float scores[ 8 ];
+        alignas ( 32 ) std::int32_t indices[ 8 ];
+        _mm256_store_ps ( scores, lane_best );
+        _mm256_store_si256 ( reinterpret_cast<__m256i *> ( indices ), lane_best_index );
+        for ( int l = 0; l < 8; ++l ) {
+            if ( scores[ l ] > best_score or ( scores[ l ] == best_score and indices[ l ] < best_index ) ) {
+                best_score = scores[ l ];
+                best_index = indices[ l ];
+            }
+        }
+    }
+#elif defined( MCTS_UCT_SSE2 )
+    if ( n_ >= 4 ) {
+        __m128 const half = _mm_set1_ps ( 0.5f ), one = _mm_set1_ps ( 1.0f ), zero = _mm_setzero_ps ( );
+        __m128 const two_log = _mm_set1_ps ( two_log_n ), unvisited = _mm_set1_ps ( std::numeric_limits<float>::max ( ) );
+        __m128i const step = _mm_set1_epi32 ( 4 );
+        __m128 lane_best   = _mm_set1_ps ( -std::numeric_limits<float>::max ( ) );
+        __m128i lane_index = _mm_setr_epi32 ( 0, 1, 2, 3 ), lane_best_index = lane_index;
+        // SSE2 has no blend: ( a & ~mask ) | ( b & mask ).
+        auto blend = [] ( __m128 a, __m128 b, __m128 mask ) noexcept { return _mm_or_ps ( _mm_andnot_ps ( mask, a ), _mm_and_ps ( mask, b ) ); };
+        for ( ; i + 4 <= n_; i += 4 ) {
+            __m128 const v       = _mm_cvtepi32_ps ( _mm_loadu_si128 ( reinterpret_cast<__m128i const *> ( visits_ + i ) ) );
+            __m128 const w       = _mm_loadu_ps ( wins_ + i );
+            __m128 const inverse = _mm_div_ps ( one, v );
+            __m128 score = _mm_add_ps ( _mm_mul_ps ( _mm_mul_ps ( half, w ), inverse ), _mm_sqrt_ps ( _mm_mul_ps ( two_log, inverse ) ) );
+            score        = blend ( score, unvisited, _mm_cmpeq_ps ( v, zero ) );
+            __m128 const better = _mm_cmpgt_ps ( score, lane_best );
+            lane_best           = blend ( lane_best, score, better );
+            lane_best_index =
+                _mm_castps_si128 ( blend ( _mm_castsi128_ps ( lane_best_index ), _mm_castsi128_ps ( lane_index ), better ) );
+            lane_index = _mm_add_epi32 ( lane_index, step );
+        }
+        alignas ( 16 ) float scores[ 4 ];
+        alignas ( 16 ) std::int32_t indices[ 4 ];
+        _mm_store_ps ( scores, lane_best );
+        _mm_store_si128 ( reinterpret_cast<__m128i *> ( indices ), lane_best_index );
+        for ( int l = 0; l < 4; ++l ) {
+            if ( scores[ l ] > best_score or ( scores[ l ] == best_score and indices[ l ] < best_index ) ) {
+                best_score = scores[ l ];
+                best_index = indices[ l ];
+            }
+        }
+    }
+#endif
+    for ( ; i < n_; ++i ) {
+        if ( float const score = uct_score ( visits_[ i ], wins_[ i ], two_log_n ); score > best_score ) {
+            best_score = score;
+            best_index = i;
+        }
+    }
+    return best_index;
+}
+
+} // namespace Mcts